@@ -1,6 +1,191 @@
 #pragma once
+#include <array>
 #include <cstddef>
 #include <cstdint>
 
+#include "qAverageColor/Types.hpp"
+#include "qAverageColor/Kernel.hpp"
+#include "qAverageColor/Stream.hpp"
+#include "qAverageColor/Concurrent.hpp"
+#include "qAverageColor/Temporal.hpp"
+#include "qAverageColor/TileCache.hpp"
+#include "qAverageColor/SummedArea.hpp"
+#include "qAverageColor/Sliding.hpp"
+#include "qAverageColor/Border.hpp"
+
 std::uint32_t AverageColorRGBA8(const std::uint32_t Pixels[], std::size_t Count);
-std::uint32_t qAverageColorRGBA8(const std::uint32_t Pixels[], std::size_t Count);
\ No newline at end of file
+std::uint32_t qAverageColorRGBA8(const std::uint32_t Pixels[], std::size_t Count);
+
+// Cache policy variants, with an explicit choice of how the pixels are brought
+// into the cache. qAverageColorRGBA8 is the default qCachePolicy
+qColorSum qSumColorRGBA8Policy(
+	const std::uint32_t Pixels[], std::size_t Count, const qCachePolicy& Policy
+);
+std::uint32_t qAverageColorRGBA8Policy(
+	const std::uint32_t Pixels[], std::size_t Count, const qCachePolicy& Policy
+);
+
+// Channel-order aware variants. Sums are labeled by channel and averages are
+// always returned in RGBA order(red in the lowest byte), whatever the order of
+// the input. qAverageColor<qChannelOrder::RGBA> is qAverageColorRGBA8
+// These are inlined from the header-only kernels in qAverageColor/Kernel.hpp,
+// which also take custom formats, ISA tiers and pixel filters
+template< qChannelOrder Order >
+inline qColorSum qSumColor(const std::uint32_t Pixels[], std::size_t Count)
+{
+	return qColorKernel::Sum<qColorKernel::OrderFormat<Order>>(Pixels, Count);
+}
+template< qChannelOrder Order >
+inline std::uint32_t qAverageColor(const std::uint32_t Pixels[], std::size_t Count)
+{
+	return qColorKernel::Average<qColorKernel::OrderFormat<Order>>(Pixels, Count);
+}
+
+// Sub-rectangle of a larger image: Width x Height pixels with Stride bytes
+// between the start of each row
+qColorSum qSumColorRGBA8Rect(
+	const std::uint32_t Pixels[], std::size_t Stride,
+	std::size_t Width, std::size_t Height,
+	const qCachePolicy& Policy = qCachePolicy{}
+);
+std::uint32_t qAverageColorRGBA8Rect(
+	const std::uint32_t Pixels[], std::size_t Stride,
+	std::size_t Width, std::size_t Height,
+	const qCachePolicy& Policy = qCachePolicy{}
+);
+// Batch of separate images, Sums[i] is the sum of the Counts[i] pixels of
+// Images[i]
+void qSumColorRGBA8Batch(
+	const std::uint32_t* const Images[], const std::size_t Counts[],
+	std::size_t ImageCount, qColorSum Sums[],
+	const qCachePolicy& Policy = qCachePolicy{}
+);
+
+// Multi-threaded variants, the pixels are split into chunks that are summed on
+// separate threads. A ThreadCount of 0 uses every hardware thread
+qColorSum qSumColorRGBA8Parallel(
+	const std::uint32_t Pixels[], std::size_t Count, std::size_t ThreadCount = 0
+);
+std::uint32_t qAverageColorRGBA8Parallel(
+	const std::uint32_t Pixels[], std::size_t Count, std::size_t ThreadCount = 0
+);
+// Multi-threaded batch, for batches that mix tiny and huge images. Large images
+// are split into chunks and small images are packed together, and threads
+// that run out of work steal from the others
+void qSumColorRGBA8BatchParallel(
+	const std::uint32_t* const Images[], const std::size_t Counts[],
+	std::size_t ImageCount, qColorSum Sums[], std::size_t ThreadCount = 0
+);
+// NUMA-aware variants, each chunk is summed by a thread pinned to the node that
+// owns the chunk's memory, using a thread for every CPU of every node. Same as
+// the Parallel variants on single-node and non-Linux hosts
+qColorSum qSumColorRGBA8NUMA(const std::uint32_t Pixels[], std::size_t Count);
+std::uint32_t qAverageColorRGBA8NUMA(const std::uint32_t Pixels[], std::size_t Count);
+
+// Approximate variants, for previews. Only about Fraction of the pixels are
+// read: the pixels are split into blocks(rows, for rectangles) and one block is
+// picked at random from each of evenly spaced strata of blocks. The error
+// bound is derived from the variance between the sampled blocks. A Fraction of
+// 1 or more reads every pixel and is exact, a Fraction of 0 or NaN reads as
+// few blocks as an error bound can be had from. Seed picks the sample
+qColorEstimate qAverageColorRGBA8Approximate(
+	const std::uint32_t Pixels[], std::size_t Count,
+	double Fraction, std::uint32_t Seed = 0
+);
+qColorEstimate qAverageColorRGBA8RectApproximate(
+	const std::uint32_t Pixels[], std::size_t Stride,
+	std::size_t Width, std::size_t Height,
+	double Fraction, std::uint32_t Seed = 0
+);
+
+// Masked variants, only pixels selected by the mask plane are averaged. The
+// average of an empty selection is 0.
+// Byte-mask: Pixels[i] is included when Mask[i] is non-zero
+qColorSum qSumColorRGBA8ByteMask(
+	const std::uint32_t Pixels[], const std::uint8_t Mask[], std::size_t Count
+);
+std::uint32_t qAverageColorRGBA8ByteMask(
+	const std::uint32_t Pixels[], const std::uint8_t Mask[], std::size_t Count
+);
+// Bit-mask: Pixels[i] is included when bit (i % 8) of Mask[i / 8] is set
+qColorSum qSumColorRGBA8BitMask(
+	const std::uint32_t Pixels[], const std::uint8_t Mask[], std::size_t Count
+);
+std::uint32_t qAverageColorRGBA8BitMask(
+	const std::uint32_t Pixels[], const std::uint8_t Mask[], std::size_t Count
+);
+
+// Chroma-key variants, pixels that are within Tolerance of the Key color in
+// every channel are excluded from the average. Key and Tolerance are packed
+// the same way as the pixels, a tolerance of 0xFF for a channel(such as alpha)
+// makes that channel always match. qColorSum::Count is the number of pixels
+// that were kept.
+qColorSum qSumColorRGBA8ChromaKey(
+	const std::uint32_t Pixels[], std::size_t Count,
+	std::uint32_t Key, std::uint32_t Tolerance
+);
+std::uint32_t qAverageColorRGBA8ChromaKey(
+	const std::uint32_t Pixels[], std::size_t Count,
+	std::uint32_t Key, std::uint32_t Tolerance
+);
+
+// RGBA16: 16 bits per channel, red in the lowest 16 bits. Averages are
+// returned at the same 16-bit depth.
+std::uint64_t AverageColorRGBA16(const std::uint64_t Pixels[], std::size_t Count);
+qColorSum qSumColorRGBA16(const std::uint64_t Pixels[], std::size_t Count);
+std::uint64_t qAverageColorRGBA16(const std::uint64_t Pixels[], std::size_t Count);
+
+// RGBA32F and RGBA16F(IEEE half-float): four consecutive channels per pixel,
+// Count is the number of pixels. Averages are returned as { R, G, B, A }.
+std::array<float, 4> qAverageColorRGBA32F(const float Pixels[], std::size_t Count);
+std::array<float, 4> qAverageColorRGBA16F(const std::uint16_t Pixels[], std::size_t Count);
+
+// Packed formats, summed straight from their packed bit-fields. Sums and
+// native averages are at the native channel depth, the ToRGBA8 variants
+// rescale the average to 8 bits per channel(opaque alpha for RGB565).
+// RGB565:   R[15:11] G[10:5]  B[4:0]
+// RGBA4444: R[15:12] G[11:8]  B[7:4]   A[3:0]
+// RGB10A2:  R[9:0]   G[19:10] B[29:20] A[31:30]
+qColorSum qSumColorRGB565(const std::uint16_t Pixels[], std::size_t Count);
+std::uint16_t qAverageColorRGB565(const std::uint16_t Pixels[], std::size_t Count);
+std::uint32_t qAverageColorRGB565ToRGBA8(const std::uint16_t Pixels[], std::size_t Count);
+
+qColorSum qSumColorRGBA4444(const std::uint16_t Pixels[], std::size_t Count);
+std::uint16_t qAverageColorRGBA4444(const std::uint16_t Pixels[], std::size_t Count);
+std::uint32_t qAverageColorRGBA4444ToRGBA8(const std::uint16_t Pixels[], std::size_t Count);
+
+qColorSum qSumColorRGB10A2(const std::uint32_t Pixels[], std::size_t Count);
+std::uint32_t qAverageColorRGB10A2(const std::uint32_t Pixels[], std::size_t Count);
+std::uint32_t qAverageColorRGB10A2ToRGBA8(const std::uint32_t Pixels[], std::size_t Count);
+
+// YCbCr formats, averaged from the plane sums and converted to RGBA8(opaque)
+// once at the end instead of per-pixel. Strides are in bytes. Chroma of 4:2:0
+// and 4:2:2 formats is weighted per chroma sample, which is exact for even
+// dimensions. Limited("video") range unless FullRange is set.
+enum class qYUVMatrix
+{
+	BT601,
+	BT709
+};
+
+// NV12: Y plane followed by an interleaved, half-resolution CbCr plane
+std::uint32_t qAverageColorNV12(
+	const std::uint8_t LumaPlane[], std::size_t LumaStride,
+	const std::uint8_t ChromaPlane[], std::size_t ChromaStride,
+	std::size_t Width, std::size_t Height,
+	qYUVMatrix Matrix, bool FullRange = false
+);
+// I420: Y plane followed by half-resolution Cb and Cr planes
+std::uint32_t qAverageColorI420(
+	const std::uint8_t LumaPlane[], std::size_t LumaStride,
+	const std::uint8_t CbPlane[], std::size_t CbStride,
+	const std::uint8_t CrPlane[], std::size_t CrStride,
+	std::size_t Width, std::size_t Height,
+	qYUVMatrix Matrix, bool FullRange = false
+);
+// YUY2: packed Y0 Cb Y1 Cr, Width must be even
+std::uint32_t qAverageColorYUY2(
+	const std::uint8_t Pixels[], std::size_t Stride,
+	std::size_t Width, std::size_t Height,
+	qYUVMatrix Matrix, bool FullRange = false
+);
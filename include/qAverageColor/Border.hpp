@@ -0,0 +1,280 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <immintrin.h>
+
+#include "Types.hpp"
+#include "Kernel.hpp"
+
+// Averages of the zones along the borders of a frame, such as the LEDs of an
+// ambient backlight. The frame is walked top to bottom just once, and each
+// row adds its spans of pixels to the zones they fall into. Zones keep their
+// sums as unreduced vectors of per-channel lanes and are only reduced to a
+// qColorSum once the zone is done, rather than reducing every narrow strided
+// span on its own. The current left and right zones are locals that the
+// compiler can keep in registers; the top and bottom zones are an array of
+// such vectors in memory, which is small enough to stay in L1.
+//
+// Zones are numbered clockwise from the top-left corner, in the order that
+// a strip of LEDs around the frame would be wired
+//
+//  | 0 | 1 | 2 | 3 |
+//  |11|         | 4|
+//  |10|         | 5|
+//  | 9 | 8 | 7 | 6 |
+//
+// Top and bottom zones span the full width of the frame and Depth rows, left
+// and right zones span the full height and Depth columns, so the corners are
+// shared by both.
+
+namespace qColorKernel
+{
+// Channel sums of any number of spans of pixels, kept as unreduced vectors.
+// Spans are summed with the same deinterleave and sad_epu8 steps as Sum, but
+// the ragged ends of each span are masked loads rather than serial loops, and
+// nothing is reduced until Sum is called. The Serial tier sums each span
+// with a plain loop
+template< typename FormatT, typename ISAT = NativeISA >
+struct SpanSum
+{
+	static_assert(
+		ISAT::Rank <= NativeISA::Rank,
+		"ISA is not enabled by the current compiler flags"
+	);
+
+	// | ASum64 | BSum64 | GSum64 | RSum64 |
+	__m256i RGBASum64 = _mm256_setzero_si256();
+	// Red, green, blue and alpha sums of the Serial tier
+	std::uint64_t SerialSum[4] = {};
+	std::uint64_t Count = 0;
+
+	void Add( const std::uint32_t Pixels[], std::size_t Count )
+	{
+		using ShufflesT = Shuffles<FormatT>;
+		this->Count += Count;
+		std::size_t i = 0;
+		if constexpr( ISAT::Rank >= AVX512BW::Rank )
+		{
+			// | ASum64 | BSum64 | GSum64 | RSum64 | x2
+			__m512i RGBASum64x2 = _mm512_setzero_si512();
+			const auto AddHexadecaPixel = [&]( __m512i HexadecaPixel )
+			{
+				// | AAAABBBBGGGGRRRR | AAAABBBBGGGGRRRR | ... x4
+				// | AAAAAAAA | BBBBBBBB | GGGGGGGG | RRRRRRRR | x2
+				const __m512i Deinterleave = Permute32(
+					_mm512_set_epi32(15, 11, 14, 10, 13, 9, 12, 8, 7, 3, 6, 2, 5, 1, 4, 0),
+					_mm512_shuffle_epi8(
+						HexadecaPixel, LoadShuffle(ShufflesT::Deinterleave512)
+					)
+				);
+				RGBASum64x2 = _mm512_add_epi64(
+					RGBASum64x2, _mm512_sad_epu8(Deinterleave, _mm512_setzero_si512())
+				);
+			};
+			for( std::size_t j = i/16; j < Count/16; j++, i += 16 )
+			{
+				AddHexadecaPixel(_mm512_loadu_si512((const __m512i*)&Pixels[i]));
+			}
+			if( i < Count )
+			{
+				// Pixels past the end of the span load as zero
+				AddHexadecaPixel(
+					_mm512_maskz_loadu_epi32(
+						_cvtu32_mask16((1u << (Count - i)) - 1), &Pixels[i]
+					)
+				);
+			}
+			RGBASum64 = _mm256_add_epi64(RGBASum64, FoldSum64(RGBASum64x2));
+		}
+		else if constexpr( ISAT::Rank >= AVX2::Rank )
+		{
+			const auto AddOctaPixel = [&]( __m256i OctaPixel )
+			{
+				// | AAAABBBBGGGGRRRR | AAAABBBBGGGGRRRR |
+				// | AAAAAAAA | BBBBBBBB | GGGGGGGG | RRRRRRRR |
+				const __m256i Deinterleave = _mm256_permutevar8x32_epi32(
+					_mm256_shuffle_epi8(
+						OctaPixel,
+						_mm256_broadcastsi128_si256(LoadShuffle(ShufflesT::Deinterleave))
+					),
+					_mm256_set_epi32(7, 3, 6, 2, 5, 1, 4, 0)
+				);
+				RGBASum64 = _mm256_add_epi64(
+					RGBASum64, _mm256_sad_epu8(Deinterleave, _mm256_setzero_si256())
+				);
+			};
+			for( std::size_t j = i/8; j < Count/8; j++, i += 8 )
+			{
+				AddOctaPixel(_mm256_loadu_si256((const __m256i*)&Pixels[i]));
+			}
+			if( i < Count )
+			{
+				// Pixels past the end of the span load as zero
+				const __m256i Mask = _mm256_cmpgt_epi32(
+					_mm256_set1_epi32(int(Count - i)),
+					_mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0)
+				);
+				AddOctaPixel(_mm256_maskload_epi32((const int*)&Pixels[i], Mask));
+			}
+		}
+		else
+		{
+			for( ; i < Count; ++i )
+			{
+				const std::uint32_t CurColor = Pixels[i];
+				SerialSum[0] += static_cast<std::uint8_t>( CurColor >> (FormatT::Red   * 8) );
+				SerialSum[1] += static_cast<std::uint8_t>( CurColor >> (FormatT::Green * 8) );
+				SerialSum[2] += static_cast<std::uint8_t>( CurColor >> (FormatT::Blue  * 8) );
+				if constexpr( !FormatT::Padded )
+				{
+					SerialSum[3] += static_cast<std::uint8_t>( CurColor >> (FormatT::Alpha * 8) );
+				}
+			}
+		}
+	}
+
+	qColorSum Sum() const
+	{
+		qColorSum Total;
+		if constexpr( ISAT::Rank < AVX2::Rank )
+		{
+			Total.Red   = SerialSum[0];
+			Total.Green = SerialSum[1];
+			Total.Blue  = SerialSum[2];
+			Total.Alpha = SerialSum[3];
+		}
+		else
+		{
+			const __m128i RedGreenSum64  = _mm256_castsi256_si128(RGBASum64);
+			const __m128i BlueAlphaSum64 = _mm256_extracti128_si256(RGBASum64, 1);
+			Total.Red   = _mm_cvtsi128_si64(RedGreenSum64);
+			Total.Green = _mm_extract_epi64(RedGreenSum64, 1);
+			Total.Blue  = _mm_cvtsi128_si64(BlueAlphaSum64);
+			Total.Alpha = _mm_extract_epi64(BlueAlphaSum64, 1);
+		}
+		Total.Count = Count;
+		// Pixels without an alpha channel are opaque
+		if constexpr( FormatT::Padded )
+		{
+			Total.Alpha = Count * 0xFF;
+		}
+		return Total;
+	}
+};
+}
+
+// Sums of the HorizontalZones zones along the top and bottom edges and the
+// VerticalZones zones along the left and right edges, each Depth pixels deep.
+// Writes 2 * (HorizontalZones + VerticalZones) sums, clockwise from the
+// top-left. Stride is in bytes
+// Every zone needs at least one column or row of its own, so HorizontalZones
+// may not be more than Width, nor VerticalZones more than Height. Any more
+// zones than that would come back empty, with a Count of 0
+template<
+	qChannelOrder Order = qChannelOrder::RGBA,
+	typename ISAT = qColorKernel::NativeISA
+>
+inline void qSumColorBorder(
+	const std::uint32_t Pixels[], std::size_t Stride,
+	std::size_t Width, std::size_t Height, std::size_t Depth,
+	std::size_t HorizontalZones, std::size_t VerticalZones,
+	qColorSum Sums[]
+)
+{
+	using FormatT = qColorKernel::OrderFormat<Order>;
+	using SpanSumT = qColorKernel::SpanSum<FormatT, ISAT>;
+	assert(HorizontalZones <= Width && VerticalZones <= Height);
+
+	// Opposite strips do not overlap each other
+	const std::size_t Rows    = std::min(Depth, Height / 2);
+	const std::size_t Columns = std::min(Depth, Width / 2);
+
+	// Top zones, then bottom zones, both left to right
+	std::vector<SpanSumT> Horizontal(HorizontalZones * 2);
+	// Left zones, then right zones, both top to bottom. Only one zone of each
+	// side is being added to at a time, the rest are done
+	std::vector<qColorSum> Vertical(VerticalZones * 2);
+	SpanSumT Left, Right;
+	std::size_t SideZone = 0;
+
+	for( std::size_t y = 0; y < Height; ++y )
+	{
+		const std::uint32_t* Row = reinterpret_cast<const std::uint32_t*>(
+			reinterpret_cast<const std::uint8_t*>(Pixels) + y * Stride
+		);
+		if( y < Rows || y >= Height - Rows )
+		{
+			SpanSumT* Zones = &Horizontal[y < Rows ? 0 : HorizontalZones];
+			for( std::size_t Zone = 0; Zone < HorizontalZones; ++Zone )
+			{
+				const std::size_t Begin = Zone * Width / HorizontalZones;
+				const std::size_t End   = (Zone + 1) * Width / HorizontalZones;
+				Zones[Zone].Add(&Row[Begin], End - Begin);
+			}
+		}
+		if( VerticalZones )
+		{
+			const std::size_t Zone = y * VerticalZones / Height;
+			if( Zone != SideZone )
+			{
+				Vertical[SideZone] = Left.Sum();
+				Vertical[VerticalZones + SideZone] = Right.Sum();
+				Left = Right = SpanSumT{};
+				SideZone = Zone;
+			}
+			Left.Add(&Row[0], Columns);
+			Right.Add(&Row[Width - Columns], Columns);
+		}
+	}
+	if( VerticalZones )
+	{
+		Vertical[SideZone] = Left.Sum();
+		Vertical[VerticalZones + SideZone] = Right.Sum();
+	}
+
+	// Clockwise from the top-left
+	qColorSum* Out = Sums;
+	for( std::size_t Zone = 0; Zone < HorizontalZones; ++Zone )
+	{
+		*Out++ = Horizontal[Zone].Sum();
+	}
+	for( std::size_t Zone = 0; Zone < VerticalZones; ++Zone )
+	{
+		*Out++ = Vertical[VerticalZones + Zone];
+	}
+	for( std::size_t Zone = HorizontalZones; Zone-- > 0; )
+	{
+		*Out++ = Horizontal[HorizontalZones + Zone].Sum();
+	}
+	for( std::size_t Zone = VerticalZones; Zone-- > 0; )
+	{
+		*Out++ = Vertical[Zone];
+	}
+}
+
+// Averages of the border zones in RGBA order, clockwise from the top-left
+template<
+	qChannelOrder Order = qChannelOrder::RGBA,
+	typename ISAT = qColorKernel::NativeISA
+>
+inline void qAverageColorBorder(
+	const std::uint32_t Pixels[], std::size_t Stride,
+	std::size_t Width, std::size_t Height, std::size_t Depth,
+	std::size_t HorizontalZones, std::size_t VerticalZones,
+	std::uint32_t Averages[]
+)
+{
+	std::vector<qColorSum> Sums(2 * (HorizontalZones + VerticalZones));
+	qSumColorBorder<Order, ISAT>(
+		Pixels, Stride, Width, Height, Depth, HorizontalZones, VerticalZones,
+		Sums.data()
+	);
+	for( std::size_t i = 0; i < Sums.size(); ++i )
+	{
+		Averages[i] = qColorKernel::PackAverageRGBA8(Sums[i]);
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "Types.hpp"
+#include "Kernel.hpp"
+
+// Running sum that any number of threads can add to at once without locks.
+// The sums are split into shards, each on its own cache lines, and every
+// thread adds into the shard it has been assigned so that producers on
+// different cores do not contend over the same cache line. Shards are only
+// merged when the sum is read.
+//
+// Adds are relaxed atomic additions. A read that races with an Add may see
+// some of that Add's channels but not others, reads made once the producers
+// are done are always exact.
+class qConcurrentColorSum
+{
+public:
+	// A ShardCount of 0 uses a shard for every hardware thread
+	explicit qConcurrentColorSum( std::size_t ShardCount = 0 )
+	: ShardCount(
+		ShardCount ? ShardCount
+		: (std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1)
+	),
+	Shards(new Shard[this->ShardCount])
+	{
+	}
+
+	// Adds partial sums, such as the qColorSum of a frame
+	void Add( const qColorSum& Sum )
+	{
+		Shard& Target = Shards[ThreadIndex() % ShardCount];
+		Target.Red.fetch_add(Sum.Red, std::memory_order_relaxed);
+		Target.Green.fetch_add(Sum.Green, std::memory_order_relaxed);
+		Target.Blue.fetch_add(Sum.Blue, std::memory_order_relaxed);
+		Target.Alpha.fetch_add(Sum.Alpha, std::memory_order_relaxed);
+		Target.Count.fetch_add(Sum.Count, std::memory_order_relaxed);
+	}
+
+	// Sums the pixels on the calling thread, and then adds them
+	void Add( const std::uint32_t Pixels[], std::size_t Count )
+	{
+		Add(
+			qColorKernel::Sum<qColorKernel::OrderFormat<qChannelOrder::RGBA>>(
+				Pixels, Count
+			)
+		);
+	}
+
+	qColorSum Sum() const
+	{
+		qColorSum Total = {};
+		for( std::size_t i = 0; i < ShardCount; ++i )
+		{
+			Total.Red   += Shards[i].Red.load(std::memory_order_relaxed);
+			Total.Green += Shards[i].Green.load(std::memory_order_relaxed);
+			Total.Blue  += Shards[i].Blue.load(std::memory_order_relaxed);
+			Total.Alpha += Shards[i].Alpha.load(std::memory_order_relaxed);
+			Total.Count += Shards[i].Count.load(std::memory_order_relaxed);
+		}
+		return Total;
+	}
+
+	std::uint32_t Average() const
+	{
+		return qColorKernel::PackAverageRGBA8(Sum());
+	}
+
+	// Not safe to call while other threads are adding
+	void Reset()
+	{
+		for( std::size_t i = 0; i < ShardCount; ++i )
+		{
+			Shards[i].Red   = 0;
+			Shards[i].Green = 0;
+			Shards[i].Blue  = 0;
+			Shards[i].Alpha = 0;
+			Shards[i].Count = 0;
+		}
+	}
+
+private:
+	// Two cache lines per shard, so the adjacent-line prefetcher does not
+	// drag a neighboring shard along with it
+	struct alignas(128) Shard
+	{
+		std::atomic<std::uint64_t> Red{0}, Green{0}, Blue{0}, Alpha{0};
+		std::atomic<std::uint64_t> Count{0};
+	};
+
+	// Threads are numbered in the order that they first add to any
+	// qConcurrentColorSum, which spreads them evenly across the shards
+	static std::size_t ThreadIndex()
+	{
+		static std::atomic<std::size_t> NextIndex{0};
+		static thread_local const std::size_t Index =
+			NextIndex.fetch_add(1, std::memory_order_relaxed);
+		return Index;
+	}
+
+	const std::size_t ShardCount;
+	const std::unique_ptr<Shard[]> Shards;
+};
@@ -0,0 +1,975 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <immintrin.h>
+
+#include "Types.hpp"
+
+// Header-only core of the 8-bit-per-channel kernels
+// Everything here is a template over
+//  - A pixel format, described by where each channel lives within a pixel
+//  - An ISA tag, the widest instruction set the kernel may use
+//  - A pixel filter, which pixels take part in the sum
+// so that a new format gets every SIMD tier without writing any new
+// intrinsics, and can be inlined straight into a caller's loop.
+namespace qColorKernel
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// ISA tags
+// Each tier handles as many pixels as it can and leaves the remainder to the
+// narrower tiers below it, down to the serial loop. AVX2 is the baseline that
+// the library is built for, Serial only exists as a reference.
+struct Serial     { static constexpr int Rank = 0; };
+struct AVX2       { static constexpr int Rank = 1; };
+struct AVX512BW   { static constexpr int Rank = 2; };
+struct AVX512VNNI { static constexpr int Rank = 3; };
+
+// Widest ISA that the current compiler flags allow
+#if defined(__AVX512VNNI__) || defined(_MSC_VER)
+using NativeISA = AVX512VNNI;
+#elif defined(__AVX512BW__)
+using NativeISA = AVX512BW;
+#else
+using NativeISA = AVX2;
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Pixel formats
+// Four 8-bit channels within a 32-bit pixel, described by the byte offset of
+// each channel in memory order. X(padding) channels have an offset of -1 and
+// are never summed, such pixels are treated as opaque.
+template< int RedOffset, int GreenOffset, int BlueOffset, int AlphaOffset >
+struct Format8888
+{
+	using PixelT = std::uint32_t;
+	static constexpr int Red   = RedOffset;
+	static constexpr int Green = GreenOffset;
+	static constexpr int Blue  = BlueOffset;
+	static constexpr int Alpha = AlphaOffset;
+	static constexpr bool Padded = AlphaOffset < 0;
+
+	static_assert(
+		RedOffset >= 0 && GreenOffset >= 0 && BlueOffset >= 0,
+		"Only the alpha channel may be absent"
+	);
+	static_assert(
+		RedOffset < 4 && GreenOffset < 4 && BlueOffset < 4 && AlphaOffset < 4,
+		"Channels must be within the 32-bit pixel"
+	);
+};
+
+constexpr std::array<int, 4> ChannelOffsets( qChannelOrder Order )
+{
+	switch( Order )
+	{
+	case qChannelOrder::RGBA: return {{  0,  1,  2,  3 }};
+	case qChannelOrder::BGRA: return {{  2,  1,  0,  3 }};
+	case qChannelOrder::ARGB: return {{  1,  2,  3,  0 }};
+	case qChannelOrder::ABGR: return {{  3,  2,  1,  0 }};
+	case qChannelOrder::RGBX: return {{  0,  1,  2, -1 }};
+	case qChannelOrder::BGRX: return {{  2,  1,  0, -1 }};
+	case qChannelOrder::XRGB: return {{  1,  2,  3, -1 }};
+	case qChannelOrder::XBGR: return {{  3,  2,  1, -1 }};
+	}
+	return {{ 0, 1, 2, 3 }};
+}
+
+template< qChannelOrder Order >
+using OrderFormat = Format8888<
+	ChannelOffsets(Order)[0], ChannelOffsets(Order)[1],
+	ChannelOffsets(Order)[2], ChannelOffsets(Order)[3]
+>;
+
+////////////////////////////////////////////////////////////////////////////////
+// Shuffle tables
+// pshufb controls for one 128-bit lane(four pixels), generated at compile-time
+// out of the format description. Absent channels shuffle in zeros.
+using ShuffleTable = std::array<std::int8_t, 16>;
+
+constexpr std::int8_t ShuffleIndex( int Offset, int Pixel )
+{
+	return Offset < 0 ? -1 : static_cast<std::int8_t>(Pixel * 4 + Offset);
+}
+
+// | ABGRABGRABGRABGR | -> | 3333222211110000 |
+// Gathers the bytes at Offset0 of each pixel into the lowest 32-bit lane,
+// the bytes at Offset1 into the next one, and so on
+constexpr ShuffleTable GatherTable(
+	int Offset0, int Offset1, int Offset2, int Offset3
+)
+{
+	const int Offsets[4] = { Offset0, Offset1, Offset2, Offset3 };
+	ShuffleTable Table = {};
+	for( std::size_t Dword = 0; Dword < 4; ++Dword )
+	{
+		for( std::size_t Pixel = 0; Pixel < 4; ++Pixel )
+		{
+			Table[Dword * 4 + Pixel] = ShuffleIndex(Offsets[Dword], int(Pixel));
+		}
+	}
+	return Table;
+}
+
+// | ABGRABGRABGRABGR | -> | -H-H-H-H | -L-L-L-L |
+constexpr ShuffleTable SpreadTable( int LowOffset, int HighOffset )
+{
+	ShuffleTable Table = {};
+	for( std::size_t Pixel = 0; Pixel < 4; ++Pixel )
+	{
+		Table[Pixel * 2 + 0] = ShuffleIndex(LowOffset, int(Pixel));
+		Table[Pixel * 2 + 1] = -1;
+		Table[Pixel * 2 + 8] = ShuffleIndex(HighOffset, int(Pixel));
+		Table[Pixel * 2 + 9] = -1;
+	}
+	return Table;
+}
+
+// The same controls in all four 128-bit lanes of a 512-bit register, as a
+// whole constant of its own rather than broadcast out of the 128-bit one
+using ShuffleTable512 = std::array<std::int8_t, 64>;
+
+constexpr ShuffleTable512 RepeatLanes( const ShuffleTable& Lane )
+{
+	ShuffleTable512 Table = {};
+	for( std::size_t i = 0; i < Table.size(); ++i )
+	{
+		Table[i] = Lane[i % Lane.size()];
+	}
+	return Table;
+}
+
+template< typename FormatT >
+struct Shuffles
+{
+	// | ABGRABGRABGRABGR | -> | AAAABBBBGGGGRRRR |
+	static constexpr ShuffleTable Deinterleave = GatherTable(
+		FormatT::Red, FormatT::Green, FormatT::Blue, FormatT::Alpha
+	);
+	// | ABGRABGRABGRABGR | -> | -G-G-G-G | -R-R-R-R |
+	static constexpr ShuffleTable RedGreen = SpreadTable(
+		FormatT::Red, FormatT::Green
+	);
+	// | ABGRABGRABGRABGR | -> | -A-A-A-A | -B-B-B-B |
+	static constexpr ShuffleTable BlueAlpha = SpreadTable(
+		FormatT::Blue, FormatT::Alpha
+	);
+	// Padded pixels only use three quarters of every deinterleaved register.
+	// Four registers of pixels are shuffled so that they can be blended into
+	// three registers of 8-byte single-channel groups instead, ready for
+	// sad_epu8 without any cross-lane permute
+	// | ZZZZGGGGBBBBRRRR | Pack[0]
+	// | GGGGZZZZRRRRBBBB | Pack[1]
+	// | BBBBGGGGZZZZRRRR | Pack[2]
+	// | GGGGBBBBRRRRZZZZ | Pack[3]
+	static constexpr ShuffleTable Pack[4] = {
+		GatherTable(FormatT::Red,  FormatT::Blue,  FormatT::Green,           -1),
+		GatherTable(FormatT::Blue, FormatT::Red,              -1, FormatT::Green),
+		GatherTable(FormatT::Red,             -1,  FormatT::Green, FormatT::Blue),
+		GatherTable(           -1, FormatT::Red,   FormatT::Blue, FormatT::Green)
+	};
+
+	// 512-bit forms of the above
+	alignas(64) static constexpr ShuffleTable512 Deinterleave512 = RepeatLanes(
+		GatherTable(FormatT::Red, FormatT::Green, FormatT::Blue, FormatT::Alpha)
+	);
+	alignas(64) static constexpr ShuffleTable512 Pack512[4] = {
+		RepeatLanes(Pack[0]), RepeatLanes(Pack[1]),
+		RepeatLanes(Pack[2]), RepeatLanes(Pack[3])
+	};
+};
+
+inline __m128i LoadShuffle( const ShuffleTable& Table )
+{
+	return _mm_loadu_si128((const __m128i*)Table.data());
+}
+
+#if defined(__AVX512BW__) || defined(_MSC_VER)
+inline __m512i LoadShuffle( const ShuffleTable512& Table )
+{
+	return _mm512_load_si512(Table.data());
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// 512-bit helpers
+// GCC 12 implements the unmasked forms of many AVX512 intrinsics, down to
+// _mm512_castsi512_si256, as masked builtins that pass an uninitialized
+// vector through for the masked-off lanes. -Wmaybe-uninitialized then reports
+// it at every call site that they are inlined into. The zero-masked forms with
+// every lane selected compile to the very same unmasked instructions.
+// AVX2 builds only call these from discarded AVX512 branches, so GCC's
+// -Wpsabi notice about returning 512-bit vectors without AVX512 is moot
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+inline __m256i Lower256( __m512i Vector )
+{
+	return _mm512_maskz_extracti64x4_epi64(0xFF, Vector, 0);
+}
+
+inline __m256i Upper256( __m512i Vector )
+{
+	return _mm512_maskz_extracti64x4_epi64(0xFF, Vector, 1);
+}
+
+// | Hi256 | Lo256 | -> Hi256 + Lo256
+inline __m256i FoldSum64( __m512i Sum64x8 )
+{
+	return _mm256_add_epi64(Lower256(Sum64x8), Upper256(Sum64x8));
+}
+
+// Zero-extends eight 32-bit lanes to 64 bits
+inline __m512i WidenUnsigned32( __m256i Vector )
+{
+	return _mm512_maskz_cvtepu32_epi64(0xFF, Vector);
+}
+
+// Sign-extends eight 32-bit lanes to 64 bits
+inline __m512i WidenSigned32( __m256i Vector )
+{
+	return _mm512_maskz_cvtepi32_epi64(0xFF, Vector);
+}
+
+inline __m512i Permute32( __m512i Index, __m512i Vector )
+{
+	return _mm512_maskz_permutexvar_epi32(0xFFFF, Index, Vector);
+}
+
+template< unsigned Shift >
+inline __m512i ShiftRight32( __m512i Vector )
+{
+	return _mm512_maskz_srli_epi32(0xFFFF, Vector, Shift);
+}
+
+inline __m512 HalfToFloat( __m256i Halves )
+{
+	return _mm512_maskz_cvtph_ps(0xFFFF, Halves);
+}
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Pixel filters
+// Pixel filters select which pixels take part in the sum.
+// Each SIMD tier asks the filter which of the pixels it just loaded are to be
+// included(AVX512 mask-register) or excluded(AVX2/SSE lane-mask) so that they
+// can be zeroed in-register rather than compacted into a separate buffer.
+struct NoFilter
+{
+	static constexpr bool Enabled = false;
+};
+
+struct ByteMaskFilter
+{
+	static constexpr bool Enabled = true;
+	const std::uint8_t* Mask;
+
+#if defined(__AVX512BW__) || defined(_MSC_VER)
+	__mmask16 Include16( std::size_t i, __m512i ) const
+	{
+		const __m128i MaskBytes = _mm_loadu_si128((const __m128i*)&Mask[i]);
+		return _mm_test_epi8_mask(MaskBytes, MaskBytes);
+	}
+#endif
+	__m256i Exclude8( std::size_t i, __m256i ) const
+	{
+		return _mm256_cmpeq_epi32(
+			_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&Mask[i])),
+			_mm256_setzero_si256()
+		);
+	}
+	__m128i Exclude4( std::size_t i, __m128i ) const
+	{
+		std::uint32_t MaskBytes;
+		std::memcpy(&MaskBytes, &Mask[i], sizeof(std::uint32_t));
+		return _mm_cmpeq_epi32(
+			_mm_cvtepu8_epi32(_mm_cvtsi32_si128(MaskBytes)),
+			_mm_setzero_si128()
+		);
+	}
+	bool Include( std::size_t i, std::uint32_t ) const
+	{
+		return Mask[i] != 0;
+	}
+};
+
+struct BitMaskFilter
+{
+	static constexpr bool Enabled = true;
+	const std::uint8_t* Mask;
+
+#if defined(__AVX512BW__) || defined(_MSC_VER)
+	__mmask16 Include16( std::size_t i, __m512i ) const
+	{
+		// i is always a multiple of 16 here
+		std::uint16_t MaskBits;
+		std::memcpy(&MaskBits, &Mask[i / 8], sizeof(std::uint16_t));
+		return _cvtu32_mask16(MaskBits);
+	}
+#endif
+	__m256i Exclude8( std::size_t i, __m256i ) const
+	{
+		// i is always a multiple of 8 here
+		return _mm256_cmpeq_epi32(
+			_mm256_and_si256(
+				_mm256_set1_epi32(Mask[i / 8]),
+				_mm256_set_epi32(128, 64, 32, 16, 8, 4, 2, 1)
+			),
+			_mm256_setzero_si256()
+		);
+	}
+	__m128i Exclude4( std::size_t i, __m128i ) const
+	{
+		// i is always a multiple of 4 here
+		return _mm_cmpeq_epi32(
+			_mm_and_si128(
+				_mm_set1_epi32(Mask[i / 8] >> (i % 8)),
+				_mm_set_epi32(8, 4, 2, 1)
+			),
+			_mm_setzero_si128()
+		);
+	}
+	bool Include( std::size_t i, std::uint32_t ) const
+	{
+		return (Mask[i / 8] >> (i % 8)) & 1;
+	}
+};
+
+struct ChromaKeyFilter
+{
+	static constexpr bool Enabled = true;
+	// Pixels that are within Tolerance of Key in all four channels are
+	// excluded
+	std::uint32_t Key;
+	std::uint32_t Tolerance;
+
+	// The per-channel |Pixel - Key| > Tolerance test is done with saturated
+	// byte arithmetic. Any non-zero byte left in the 32-bit pixel means that
+	// channel is out of tolerance and the pixel is kept
+	// | max(Pixel - Key, 0) | max(Key - Pixel, 0) | = |Pixel - Key|
+	// max(|Pixel - Key| - Tolerance, 0)
+#if defined(__AVX512BW__) || defined(_MSC_VER)
+	__mmask16 Include16( std::size_t, __m512i HexadecaPixel ) const
+	{
+		const __m512i KeyColor = _mm512_set1_epi32(Key);
+		const __m512i OutOfTolerance = _mm512_subs_epu8(
+			_mm512_or_si512(
+				_mm512_subs_epu8(HexadecaPixel, KeyColor),
+				_mm512_subs_epu8(KeyColor, HexadecaPixel)
+			),
+			_mm512_set1_epi32(Tolerance)
+		);
+		return _mm512_test_epi32_mask(OutOfTolerance, OutOfTolerance);
+	}
+#endif
+	__m256i Exclude8( std::size_t, __m256i OctaPixel ) const
+	{
+		const __m256i KeyColor = _mm256_set1_epi32(Key);
+		const __m256i OutOfTolerance = _mm256_subs_epu8(
+			_mm256_or_si256(
+				_mm256_subs_epu8(OctaPixel, KeyColor),
+				_mm256_subs_epu8(KeyColor, OctaPixel)
+			),
+			_mm256_set1_epi32(Tolerance)
+		);
+		return _mm256_cmpeq_epi32(OutOfTolerance, _mm256_setzero_si256());
+	}
+	__m128i Exclude4( std::size_t, __m128i QuadPixel ) const
+	{
+		const __m128i KeyColor = _mm_set1_epi32(Key);
+		const __m128i OutOfTolerance = _mm_subs_epu8(
+			_mm_or_si128(
+				_mm_subs_epu8(QuadPixel, KeyColor),
+				_mm_subs_epu8(KeyColor, QuadPixel)
+			),
+			_mm_set1_epi32(Tolerance)
+		);
+		return _mm_cmpeq_epi32(OutOfTolerance, _mm_setzero_si128());
+	}
+	bool Include( std::size_t, std::uint32_t CurColor ) const
+	{
+		for( std::size_t Channel = 0; Channel < 4; ++Channel )
+		{
+			const std::uint8_t PixelByte = CurColor >> (Channel * 8);
+			const std::uint8_t KeyByte = Key >> (Channel * 8);
+			const std::uint8_t ToleranceByte = Tolerance >> (Channel * 8);
+			const std::uint8_t Difference = PixelByte > KeyByte
+				? PixelByte - KeyByte : KeyByte - PixelByte;
+			if( Difference > ToleranceByte ) return true;
+		}
+		return false;
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Kernel
+
+// Folds the sums of the packed registers into RGBA sums
+// | GSum64 | RSum64 | GSum64 | RSum64 |
+// | BSum64 | BSum64 | BSum64 | BSum64 |
+// | ASum64 | BSum64 | GSum64 | RSum64 | Alpha is always 0
+inline __m256i FoldPackedSums( __m256i RedGreenSum64x2, __m256i BlueSum64x4 )
+{
+	const __m128i RedGreenSum64 = _mm_add_epi64(
+		_mm256_castsi256_si128(RedGreenSum64x2),
+		_mm256_extracti128_si256(RedGreenSum64x2, 1)
+	);
+	__m128i BlueSum64 = _mm_add_epi64(
+		_mm256_castsi256_si128(BlueSum64x4),
+		_mm256_extracti128_si256(BlueSum64x4, 1)
+	);
+	BlueSum64 = _mm_move_epi64(
+		_mm_add_epi64(BlueSum64, _mm_unpackhi_epi64(BlueSum64, BlueSum64))
+	);
+	return _mm256_set_m128i(BlueSum64, RedGreenSum64);
+}
+
+template<
+	typename FormatT,
+	typename ISAT = NativeISA,
+	typename FilterT = NoFilter
+>
+inline qColorSum Sum(
+	const std::uint32_t Pixels[],
+	std::size_t Count,
+	const FilterT& Filter = FilterT{},
+	const qCachePolicy& Policy = qCachePolicy{}
+)
+{
+	static_assert(
+		ISAT::Rank <= NativeISA::Rank,
+		"ISA is not enabled by the current compiler flags"
+	);
+	using ShufflesT = Shuffles<FormatT>;
+
+	// Software prefetching, issued along with each SIMD load
+	const bool NonTemporal = Policy.Hint == qCacheHint::NonTemporal;
+	const std::size_t PrefetchDistance = (NonTemporal && !Policy.PrefetchDistance)
+		? qCachePolicy::DefaultNonTemporalDistance : Policy.PrefetchDistance;
+	const auto Prefetch = [&]( std::size_t Index )
+	{
+		if( PrefetchDistance == 0 ) return;
+		// Prefetches never fault, running off the end of the buffer is fine
+		const char* Address =
+			reinterpret_cast<const char*>(&Pixels[Index]) + PrefetchDistance;
+		if( NonTemporal ) _mm_prefetch(Address, _MM_HINT_NTA);
+		else              _mm_prefetch(Address, _MM_HINT_T0);
+	};
+
+	std::size_t i = 0;
+	// Number of pixels that made it through the filter
+	std::uint64_t Included = 0;
+
+	// | ASum64 | BSum64 | GSum64 | RSum64 |
+	__m256i RGBASum64 = _mm256_setzero_si256();
+
+	if constexpr( ISAT::Rank >= AVX512BW::Rank )
+	{
+		const auto LoadHexadecaPixel = [&]( std::size_t Index ) -> __m512i
+		{
+			Prefetch(Index);
+			__m512i HexadecaPixel = _mm512_loadu_si512((const __m512i*)&Pixels[Index]);
+			if constexpr( FilterT::Enabled )
+			{
+				// Zero out the excluded pixels so they add nothing to the sum
+				const __mmask16 Include = Filter.Include16(Index, HexadecaPixel);
+				HexadecaPixel = _mm512_maskz_mov_epi32(Include, HexadecaPixel);
+				Included += _mm_popcnt_u32(_cvtmask16_u32(Include));
+			}
+			return HexadecaPixel;
+		};
+
+		if constexpr( FormatT::Padded )
+		{
+			// 64 pixels at a time! (AVX512, no alpha)
+			// The packed sad_epu8 loop outruns vpdpbusd, so VNNI takes this
+			// path too
+			// | GSum64 | RSum64 | x4
+			__m512i RedGreenSum64x4 = _mm512_setzero_si512();
+			// | BSum64 | BSum64 | x4
+			__m512i BlueSum64x8     = _mm512_setzero_si512();
+			for( std::size_t j = i/64; j < Count/64; j++, i += 64 )
+			{
+				const __m512i Pixels0 = _mm512_shuffle_epi8(
+					LoadHexadecaPixel(i +  0),
+					LoadShuffle(ShufflesT::Pack512[0])
+				);
+				const __m512i Pixels1 = _mm512_shuffle_epi8(
+					LoadHexadecaPixel(i + 16),
+					LoadShuffle(ShufflesT::Pack512[1])
+				);
+				const __m512i Pixels2 = _mm512_shuffle_epi8(
+					LoadHexadecaPixel(i + 32),
+					LoadShuffle(ShufflesT::Pack512[2])
+				);
+				const __m512i Pixels3 = _mm512_shuffle_epi8(
+					LoadHexadecaPixel(i + 48),
+					LoadShuffle(ShufflesT::Pack512[3])
+				);
+				// | GGGGGGGG | RRRRRRRR | x4
+				const __m512i RedGreen01 = _mm512_mask_blend_epi32(
+					_cvtu32_mask16(0b1010101010101010), Pixels0, Pixels1
+				);
+				const __m512i RedGreen23 = _mm512_mask_blend_epi32(
+					_cvtu32_mask16(0b1010101010101010), Pixels2, Pixels3
+				);
+				// | BBBBBBBB | BBBBBBBB | x4
+				const __m512i Blue0123 = _mm512_mask_blend_epi32(
+					_cvtu32_mask16(0b1100110011001100),
+					_mm512_mask_blend_epi32(
+						_cvtu32_mask16(0b0001000100010001), Pixels0, Pixels1
+					),
+					_mm512_mask_blend_epi32(
+						_cvtu32_mask16(0b0100010001000100), Pixels2, Pixels3
+					)
+				);
+				RedGreenSum64x4 = _mm512_add_epi64(
+					RedGreenSum64x4,
+					_mm512_sad_epu8(RedGreen01, _mm512_setzero_si512())
+				);
+				RedGreenSum64x4 = _mm512_add_epi64(
+					RedGreenSum64x4,
+					_mm512_sad_epu8(RedGreen23, _mm512_setzero_si512())
+				);
+				BlueSum64x8 = _mm512_add_epi64(
+					BlueSum64x8,
+					_mm512_sad_epu8(Blue0123, _mm512_setzero_si512())
+				);
+			}
+			RGBASum64 = _mm256_add_epi64(
+				RGBASum64,
+				FoldPackedSums(
+					FoldSum64(RedGreenSum64x4), FoldSum64(BlueSum64x8)
+				)
+			);
+		}
+
+		// 16 pixels at a time! (AVX512)
+		// | ASum64 | BSum64 | GSum64 | RSum64 | ASum64 | BSum64 | GSum64 | RSum64 |
+		__m512i RGBASum64x2  = _mm512_setzero_si512();
+		if constexpr( ISAT::Rank >= AVX512VNNI::Rank )
+		{
+			for( std::size_t j = i/16; j < Count/16; )
+			{
+				// 32-bit accumulators
+				__m512i RGBASum32x4 = _mm512_setzero_si512();
+				// In the worst case, where all the bytes are just 0xFF:
+				// We are horizontally summing 4 channel-bytes at a time into a 32-bit
+				// accumulator. The 32-bit accumulator would overflow after-
+				// ( (0xFFFFFFFF / ( 0xFF * 4 ) ) = >>> 0x404040 iterations <<<
+				//       ^             ^    ^ Number of bytes summed into accumulator
+				//       |             |      at each iteration
+				//       |             | a saturated channel bytechannel
+				//       | a saturated register is made out of...
+				#define SPANDOT4 (0xFFFFFFFF / ( 0xFF * 4 ) )
+				for(
+					std::size_t k = 0;
+					(k < SPANDOT4) && (j < Count/16);
+					k++, j++, i += 16
+				)
+				{
+				#undef SPANDOT4
+					const __m512i HexadecaPixel = LoadHexadecaPixel(i);
+					// Setting up for vpdpbusd
+					// Shuffle within 128-bit lanes
+					// | ABGRABGRABGRABGR | ABGRABGRABGRABGR | ... x4
+					// | AAAABBBBGGGGRRRR | AAAABBBBGGGGRRRR | ... x4
+					const __m512i Deinterleave = _mm512_shuffle_epi8(
+						HexadecaPixel,
+						LoadShuffle(ShufflesT::Deinterleave512)
+					);
+					// VNNI: basically an does a R^4 dot product to each group of
+					// 4 bytes into a 32-bit accumulator
+
+					// Dest = Dest + (a[i + 0] * b[i + 0])
+					//             + (a[i + 1] * b[i + 1])
+					//             + (a[i + 2] * b[i + 2])
+					//             + (a[i + 3] * b[i + 3])
+					// Dest += + (a[i + 0] * 1)
+					//         + (a[i + 1] * 1)
+					//         + (a[i + 2] * 1)
+					//         + (a[i + 3] * 1)
+					// | AAAA | BBBB | GGGG | RRRR | AAAA | BBBB | GGGG | RRRR | x2
+					// | **** | **** | **** | **** | **** | **** | **** | **** |
+					// | 1111 | 1111 | 1111 | 1111 | 1111 | 1111 | 1111 | 1111 | x2
+					// | hadd | hadd | hadd | hadd | hadd | hadd | hadd | hadd |
+					// |ASum32|BSum32|GSum32|RSum32|ASum32|BSum32|GSum32|RSum32| x2
+					RGBASum32x4 = _mm512_dpbusd_epi32(
+						RGBASum32x4, Deinterleave, _mm512_set1_epi8(1)
+					);
+				}
+				// Lower Sum32s
+				RGBASum64x2 = _mm512_add_epi64(
+					RGBASum64x2,
+					WidenUnsigned32(Lower256(RGBASum32x4))
+				);
+				// Upper Sum32s
+				RGBASum64x2 = _mm512_add_epi64(
+					RGBASum64x2,
+					WidenUnsigned32(Upper256(RGBASum32x4))
+				);
+			}
+		}
+		else
+		{
+			for( std::size_t j = i/16; j < Count/16; j++, i += 16 )
+			{
+				const __m512i HexadecaPixel = LoadHexadecaPixel(i);
+				// Shuffle within 128-bit lanes
+				// | ABGRABGRABGRABGR | ABGRABGRABGRABGR | ... x4
+				// | AAAABBBBGGGGRRRR | AAAABBBBGGGGRRRR | ... x4
+				__m512i Deinterleave = _mm512_shuffle_epi8(
+					HexadecaPixel,
+					LoadShuffle(ShufflesT::Deinterleave512)
+				);
+				// Cross-lane shuffle
+				// | AAAABBBBGGGGRRRR | AAAABBBBGGGGRRRR | ... x4
+				// | AAAAAAAA | BBBBBBBB | GGGGGGGG | RRRRRRRR | x2
+				// Setting up for 64-bit lane sad_epu8
+				Deinterleave = Permute32(
+					_mm512_set_epi32(
+						// Alpha
+						15,11,
+						// Blue
+						14,10,
+						// Green
+						13, 9,
+						// Red
+						12, 8,
+						// Alpha
+						 7, 3,
+						// Blue
+						 6, 2,
+						// Green
+						 5, 1,
+						// Red
+						 4, 0
+					),
+					Deinterleave
+				);
+				// | ASum64 | BSum64 | GSum64 | RSum64 | x2
+				RGBASum64x2 = _mm512_add_epi64(
+					RGBASum64x2,
+					_mm512_sad_epu8(
+						Deinterleave,
+						_mm512_setzero_si512()
+					)
+				);
+			}
+		}
+
+		// | ASum64 | BSum64 | GSum64 | RSum64 |
+		RGBASum64 = _mm256_add_epi64(RGBASum64, FoldSum64(RGBASum64x2));
+	}
+
+	if constexpr( ISAT::Rank >= AVX2::Rank )
+	{
+		const auto LoadOctaPixel = [&]( std::size_t Index ) -> __m256i
+		{
+			Prefetch(Index);
+			__m256i OctaPixel = _mm256_loadu_si256((const __m256i*)&Pixels[Index]);
+			if constexpr( FilterT::Enabled )
+			{
+				// Zero out the excluded pixels so they add nothing to the sum
+				const __m256i Exclude = Filter.Exclude8(Index, OctaPixel);
+				OctaPixel = _mm256_andnot_si256(Exclude, OctaPixel);
+				Included += 8 - _mm_popcnt_u32(
+					_mm256_movemask_ps(_mm256_castsi256_ps(Exclude))
+				);
+			}
+			return OctaPixel;
+		};
+
+		if constexpr( FormatT::Padded && ISAT::Rank < AVX512BW::Rank )
+		{
+			// 32 pixels at a time! (AVX2, no alpha)
+			// | GSum64 | RSum64 | x2
+			__m256i RedGreenSum64x2 = _mm256_setzero_si256();
+			// | BSum64 | BSum64 | x2
+			__m256i BlueSum64x4     = _mm256_setzero_si256();
+			for( std::size_t j = i/32; j < Count/32; j++, i += 32 )
+			{
+				const __m256i Pixels0 = _mm256_shuffle_epi8(
+					LoadOctaPixel(i +  0),
+					_mm256_broadcastsi128_si256(LoadShuffle(ShufflesT::Pack[0]))
+				);
+				const __m256i Pixels1 = _mm256_shuffle_epi8(
+					LoadOctaPixel(i +  8),
+					_mm256_broadcastsi128_si256(LoadShuffle(ShufflesT::Pack[1]))
+				);
+				const __m256i Pixels2 = _mm256_shuffle_epi8(
+					LoadOctaPixel(i + 16),
+					_mm256_broadcastsi128_si256(LoadShuffle(ShufflesT::Pack[2]))
+				);
+				const __m256i Pixels3 = _mm256_shuffle_epi8(
+					LoadOctaPixel(i + 24),
+					_mm256_broadcastsi128_si256(LoadShuffle(ShufflesT::Pack[3]))
+				);
+				// | GGGGGGGG | RRRRRRRR | x2
+				const __m256i RedGreen01 = _mm256_blend_epi32(
+					Pixels0, Pixels1, 0b10101010
+				);
+				const __m256i RedGreen23 = _mm256_blend_epi32(
+					Pixels2, Pixels3, 0b10101010
+				);
+				// | BBBBBBBB | BBBBBBBB | x2
+				const __m256i Blue0123 = _mm256_blend_epi32(
+					_mm256_blend_epi32(Pixels0, Pixels1, 0b00010001),
+					_mm256_blend_epi32(Pixels2, Pixels3, 0b01000100),
+					0b11001100
+				);
+				RedGreenSum64x2 = _mm256_add_epi64(
+					RedGreenSum64x2,
+					_mm256_sad_epu8(RedGreen01, _mm256_setzero_si256())
+				);
+				RedGreenSum64x2 = _mm256_add_epi64(
+					RedGreenSum64x2,
+					_mm256_sad_epu8(RedGreen23, _mm256_setzero_si256())
+				);
+				BlueSum64x4 = _mm256_add_epi64(
+					BlueSum64x4,
+					_mm256_sad_epu8(Blue0123, _mm256_setzero_si256())
+				);
+			}
+			RGBASum64 = _mm256_add_epi64(
+				RGBASum64, FoldPackedSums(RedGreenSum64x2, BlueSum64x4)
+			);
+		}
+
+		// 8 pixels at a time! (AVX/AVX2)
+		// Bounded on i itself rather than on a separate j = i/8 counter. The
+		// tiers above leave i wherever they stopped, and with a constant Count
+		// the compiler could not tie the two together and bound the loop
+		for( ; i + 8 <= Count; i += 8 )
+		{
+			const __m256i OctaPixel = LoadOctaPixel(i);
+			// Shuffle within 128-bit lanes
+			// | ABGRABGRABGRABGR | ABGRABGRABGRABGR |
+			// | AAAABBBBGGGGRRRR | AAAABBBBGGGGRRRR |
+			// Setting up for 64-bit lane sad_epu8
+			__m256i Deinterleave = _mm256_shuffle_epi8(
+				OctaPixel,
+				_mm256_broadcastsi128_si256(LoadShuffle(ShufflesT::Deinterleave))
+			);
+			// Cross-lane shuffle
+			// | AAAABBBBGGGGRRRR | AAAABBBBGGGGRRRR |
+			// | AAAAAAAA | BBBBBBBB | GGGGGGGG | RRRRRRRR |
+			Deinterleave = _mm256_permutevar8x32_epi32(
+				Deinterleave,
+				_mm256_set_epi32(
+					// Alpha
+					7, 3,
+					// Blue
+					6, 2,
+					// Green
+					5, 1,
+					// Red
+					4, 0
+				)
+			);
+			// | ASum64 | BSum64 | GSum64 | RSum64 |
+			RGBASum64 = _mm256_add_epi64(
+				RGBASum64,
+				_mm256_sad_epu8(
+					Deinterleave,
+					_mm256_setzero_si256()
+				)
+			);
+		}
+	}
+
+	// 4 pixels at a time! (SSE)
+	__m128i BlueAlphaSum64  = _mm256_extractf128_si256(RGBASum64,1);
+	__m128i RedGreenSum64 = _mm256_castsi256_si128(RGBASum64);
+	if constexpr( ISAT::Rank >= AVX2::Rank )
+	{
+		// Bounded on i itself, like the 8-pixel loop
+		for( ; i + 4 <= Count; i += 4 )
+		{
+			__m128i QuadPixel = _mm_loadu_si128((const __m128i*)&Pixels[i]);
+			if constexpr( FilterT::Enabled )
+			{
+				// Zero out the excluded pixels so they add nothing to the sum
+				const __m128i Exclude = Filter.Exclude4(i, QuadPixel);
+				QuadPixel = _mm_andnot_si128(Exclude, QuadPixel);
+				Included += 4 - _mm_popcnt_u32(
+					_mm_movemask_ps(_mm_castsi128_ps(Exclude))
+				);
+			}
+			// | GGGGGGGG | RRRRRRRR | GGGGGGGG | RRRRRRRR |
+			RedGreenSum64 = _mm_add_epi64(
+				RedGreenSum64,
+				_mm_sad_epu8(
+					_mm_shuffle_epi8(QuadPixel, LoadShuffle(ShufflesT::RedGreen)),
+					_mm_setzero_si128()
+				)
+			);
+			// | AAAAAAAA | BBBBBBBB | AAAAAAAA | BBBBBBBB |
+			BlueAlphaSum64 = _mm_add_epi64(
+				BlueAlphaSum64,
+				_mm_sad_epu8(
+					_mm_shuffle_epi8(QuadPixel, LoadShuffle(ShufflesT::BlueAlpha)),
+					_mm_setzero_si128()
+				)
+			);
+		}
+	}
+
+	// Horizontal sum into just one 64-bit sum now
+	qColorSum Sum;
+	Sum.Red   = _mm_cvtsi128_si64(RedGreenSum64);
+	Sum.Green = _mm_extract_epi64(RedGreenSum64,1);
+	Sum.Blue  = _mm_cvtsi128_si64(BlueAlphaSum64);
+	Sum.Alpha = _mm_extract_epi64(BlueAlphaSum64,1);
+
+	// Serial
+	for( ; i < Count; ++i )
+	{
+		const std::uint32_t CurColor = Pixels[i];
+		if constexpr( FilterT::Enabled )
+		{
+			if( !Filter.Include(i, CurColor) ) continue;
+			++Included;
+		}
+		Sum.Red   += static_cast<std::uint8_t>( CurColor >> (FormatT::Red   * 8) );
+		Sum.Green += static_cast<std::uint8_t>( CurColor >> (FormatT::Green * 8) );
+		Sum.Blue  += static_cast<std::uint8_t>( CurColor >> (FormatT::Blue  * 8) );
+		if constexpr( !FormatT::Padded )
+		{
+			Sum.Alpha += static_cast<std::uint8_t>( CurColor >> (FormatT::Alpha * 8) );
+		}
+	}
+
+	Sum.Count = FilterT::Enabled ? Included : Count;
+	// Pixels without an alpha channel are opaque
+	if constexpr( FormatT::Padded )
+	{
+		Sum.Alpha = Sum.Count * 0xFF;
+	}
+	return Sum;
+}
+
+// Average of the sums, interleaved into an RGBA8 pixel
+// The average of no pixels at all is 0
+inline std::uint32_t PackAverageRGBA8( const qColorSum& Sum )
+{
+	if( Sum.Count == 0 ) return 0;
+
+	// Average
+	const std::uint64_t RedAverage   = Sum.Red   / Sum.Count;
+	const std::uint64_t GreenAverage = Sum.Green / Sum.Count;
+	const std::uint64_t BlueAverage  = Sum.Blue  / Sum.Count;
+	const std::uint64_t AlphaAverage = Sum.Alpha / Sum.Count;
+
+	// Interleave
+	return
+		(static_cast<std::uint32_t>( (std::uint8_t)AlphaAverage ) << 24 ) |
+		(static_cast<std::uint32_t>( (std::uint8_t) BlueAverage ) << 16 ) |
+		(static_cast<std::uint32_t>( (std::uint8_t)GreenAverage ) <<  8 ) |
+		(static_cast<std::uint32_t>( (std::uint8_t)  RedAverage ) <<  0 );
+}
+
+template<
+	typename FormatT,
+	typename ISAT = NativeISA,
+	typename FilterT = NoFilter
+>
+inline std::uint32_t Average(
+	const std::uint32_t Pixels[],
+	std::size_t Count,
+	const FilterT& Filter = FilterT{},
+	const qCachePolicy& Policy = qCachePolicy{}
+)
+{
+	return PackAverageRGBA8(Sum<FormatT, ISAT>(Pixels, Count, Filter, Policy));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Rectangles and batches
+// Every new row of a sub-rectangle, and every new image of a batch, is a
+// discontinuity that the hardware prefetchers have to spend a few misses on
+// before they catch on. The start of the rows or images coming up is
+// prefetched in software instead
+
+// Up to this many bytes of the start of an upcoming row or image are
+// prefetched, after which the hardware prefetchers take over
+constexpr std::size_t AheadPrefetchBytes = 1024;
+
+inline void PrefetchAhead( const void* Start, std::size_t Size, qCacheHint Hint )
+{
+	const std::uintptr_t Begin = reinterpret_cast<std::uintptr_t>(Start);
+	const std::uintptr_t End =
+		Begin + (Size < AheadPrefetchBytes ? Size : AheadPrefetchBytes);
+	for( std::uintptr_t Line = Begin & ~std::uintptr_t(63); Line < End; Line += 64 )
+	{
+		if( Hint == qCacheHint::NonTemporal )
+		{
+			_mm_prefetch(reinterpret_cast<const char*>(Line), _MM_HINT_NTA);
+		}
+		else
+		{
+			_mm_prefetch(reinterpret_cast<const char*>(Line), _MM_HINT_T0);
+		}
+	}
+}
+
+// Width x Height pixels, with Stride bytes from the start of one row to the
+// start of the next
+template< typename FormatT, typename ISAT = NativeISA >
+inline qColorSum SumRect(
+	const std::uint32_t Pixels[],
+	std::size_t Stride,
+	std::size_t Width,
+	std::size_t Height,
+	const qCachePolicy& Policy = qCachePolicy{}
+)
+{
+	const std::uint8_t* Rows = reinterpret_cast<const std::uint8_t*>(Pixels);
+	qColorSum RectSum = {};
+	for( std::size_t y = 0; y < Height; ++y )
+	{
+		if( Policy.PrefetchAhead && y + Policy.PrefetchAhead < Height )
+		{
+			PrefetchAhead(
+				Rows + (y + Policy.PrefetchAhead) * Stride,
+				Width * sizeof(std::uint32_t), Policy.Hint
+			);
+		}
+		RectSum += Sum<FormatT, ISAT>(
+			reinterpret_cast<const std::uint32_t*>(Rows + y * Stride),
+			Width, NoFilter{}, Policy
+		);
+	}
+	return RectSum;
+}
+
+// Separate sums of ImageCount separate images
+template< typename FormatT, typename ISAT = NativeISA >
+inline void SumBatch(
+	const std::uint32_t* const Images[],
+	const std::size_t Counts[],
+	std::size_t ImageCount,
+	qColorSum Sums[],
+	const qCachePolicy& Policy = qCachePolicy{}
+)
+{
+	for( std::size_t i = 0; i < ImageCount; ++i )
+	{
+		if( Policy.PrefetchAhead && i + Policy.PrefetchAhead < ImageCount )
+		{
+			const std::size_t Ahead = i + Policy.PrefetchAhead;
+			PrefetchAhead(
+				Images[Ahead], Counts[Ahead] * sizeof(std::uint32_t), Policy.Hint
+			);
+		}
+		Sums[i] = Sum<FormatT, ISAT>(Images[i], Counts[i], NoFilter{}, Policy);
+	}
+}
+
+}
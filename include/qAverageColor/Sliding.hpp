@@ -0,0 +1,180 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <immintrin.h>
+
+#include "Types.hpp"
+#include "Kernel.hpp"
+
+// Box averages of a window sliding along a strip of pixels, such as the LEDs
+// along the edge of a screen. Each step of the window only adds the column(or
+// row) entering the window and subtracts the one leaving it, rather than
+// summing the whole window again, so every window costs the same no matter
+// how wide it is.
+
+namespace qColorKernel
+{
+// Window sums in 64-bit lanes, to an average in RGBA order
+template< typename FormatT >
+inline std::uint32_t PackWindowAverage( __m256i Window, std::uint64_t Count )
+{
+	qColorSum WindowSum;
+	WindowSum.Red   = _mm256_extract_epi64(Window, 0);
+	WindowSum.Green = _mm256_extract_epi64(Window, 1);
+	WindowSum.Blue  = _mm256_extract_epi64(Window, 2);
+	WindowSum.Alpha = FormatT::Padded ? Count * 0xFF : _mm256_extract_epi64(Window, 3);
+	WindowSum.Count = Count;
+	return PackAverageRGBA8(WindowSum);
+}
+}
+
+// Averages of every WindowWidth x Height window of a Width x Height strip, left
+// to right. Writes Width - WindowWidth + 1 averages, in RGBA order.
+// Stride is in bytes
+template< qChannelOrder Order = qChannelOrder::RGBA >
+inline void qSlidingAverageColorHorizontal(
+	const std::uint32_t Pixels[], std::size_t Stride,
+	std::size_t Width, std::size_t Height,
+	std::size_t WindowWidth, std::uint32_t Averages[]
+)
+{
+	using FormatT = qColorKernel::OrderFormat<Order>;
+	if( WindowWidth == 0 || WindowWidth > Width ) return;
+
+	// Column sums, four channels per column. 32 bits hold up to 16.8M rows
+	std::vector<std::uint32_t> Columns(Width * 4, 0);
+	const std::size_t Groups = Width / 4;
+
+	// | ABGRABGRABGRABGR | -> | AAAABBBBGGGGRRRR |
+	// A lone pixel in the lowest lane deinterleaves into | 000A000B000G000R |
+	const __m128i Deinterleave = qColorKernel::LoadShuffle(
+		qColorKernel::Shuffles<FormatT>::Deinterleave
+	);
+	for( std::size_t y = 0; y < Height; ++y )
+	{
+		const std::uint32_t* Row = reinterpret_cast<const std::uint32_t*>(
+			reinterpret_cast<const std::uint8_t*>(Pixels) + y * Stride
+		);
+		// Four columns at a time, summed one channel after the other
+		// | G3 | G2 | G1 | G0 | R3 | R2 | R1 | R0 |
+		// | A3 | A2 | A1 | A0 | B3 | B2 | B1 | B0 |
+		std::size_t x = 0;
+		for( std::size_t j = 0; j < Groups; j++, x += 4 )
+		{
+			const __m128i Channels = _mm_shuffle_epi8(
+				_mm_loadu_si128((const __m128i*)&Row[x]), Deinterleave
+			);
+			__m256i* RedGreen  = (__m256i*)&Columns[x * 4 + 0];
+			__m256i* BlueAlpha = (__m256i*)&Columns[x * 4 + 8];
+			_mm256_storeu_si256(
+				RedGreen,
+				_mm256_add_epi32(
+					_mm256_loadu_si256(RedGreen), _mm256_cvtepu8_epi32(Channels)
+				)
+			);
+			_mm256_storeu_si256(
+				BlueAlpha,
+				_mm256_add_epi32(
+					_mm256_loadu_si256(BlueAlpha),
+					_mm256_cvtepu8_epi32(_mm_srli_si128(Channels, 8))
+				)
+			);
+		}
+		// | A | B | G | R |
+		for( ; x < Width; ++x )
+		{
+			__m128i* Column = (__m128i*)&Columns[x * 4];
+			_mm_storeu_si128(
+				Column,
+				_mm_add_epi32(
+					_mm_loadu_si128(Column),
+					_mm_shuffle_epi8(_mm_cvtsi32_si128(Row[x]), Deinterleave)
+				)
+			);
+		}
+	}
+
+	// Transpose the groups of four columns so that every column's channels
+	// are side by side
+	// | R3 | R2 | R1 | R0 |    | A0 | B0 | G0 | R0 |
+	// | G3 | G2 | G1 | G0 | -> | A1 | B1 | G1 | R1 |
+	// | B3 | B2 | B1 | B0 |    | A2 | B2 | G2 | R2 |
+	// | A3 | A2 | A1 | A0 |    | A3 | B3 | G3 | R3 |
+	for( std::size_t j = 0; j < Groups; ++j )
+	{
+		__m128i* Group = (__m128i*)&Columns[j * 16];
+		const __m128i Red   = _mm_loadu_si128(Group + 0);
+		const __m128i Green = _mm_loadu_si128(Group + 1);
+		const __m128i Blue  = _mm_loadu_si128(Group + 2);
+		const __m128i Alpha = _mm_loadu_si128(Group + 3);
+		const __m128i RedGreenLo  = _mm_unpacklo_epi32(Red, Green);
+		const __m128i RedGreenHi  = _mm_unpackhi_epi32(Red, Green);
+		const __m128i BlueAlphaLo = _mm_unpacklo_epi32(Blue, Alpha);
+		const __m128i BlueAlphaHi = _mm_unpackhi_epi32(Blue, Alpha);
+		_mm_storeu_si128(Group + 0, _mm_unpacklo_epi64(RedGreenLo, BlueAlphaLo));
+		_mm_storeu_si128(Group + 1, _mm_unpackhi_epi64(RedGreenLo, BlueAlphaLo));
+		_mm_storeu_si128(Group + 2, _mm_unpacklo_epi64(RedGreenHi, BlueAlphaHi));
+		_mm_storeu_si128(Group + 3, _mm_unpackhi_epi64(RedGreenHi, BlueAlphaHi));
+	}
+
+	const auto Column = [&]( std::size_t x ) -> __m256i
+	{
+		return _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i*)&Columns[x * 4]));
+	};
+	const std::uint64_t Count = std::uint64_t(WindowWidth) * Height;
+
+	// | ASum64 | BSum64 | GSum64 | RSum64 |
+	__m256i Window = _mm256_setzero_si256();
+	for( std::size_t x = 0; x < WindowWidth; ++x )
+	{
+		Window = _mm256_add_epi64(Window, Column(x));
+	}
+	Averages[0] = qColorKernel::PackWindowAverage<FormatT>(Window, Count);
+	for( std::size_t x = WindowWidth; x < Width; ++x )
+	{
+		Window = _mm256_sub_epi64(
+			_mm256_add_epi64(Window, Column(x)), Column(x - WindowWidth)
+		);
+		Averages[x - WindowWidth + 1] = qColorKernel::PackWindowAverage<FormatT>(
+			Window, Count
+		);
+	}
+}
+
+// Averages of every Width x WindowHeight window of a Width x Height strip, top
+// to bottom. Writes Height - WindowHeight + 1 averages, in RGBA order.
+// Stride is in bytes
+template< qChannelOrder Order = qChannelOrder::RGBA >
+inline void qSlidingAverageColorVertical(
+	const std::uint32_t Pixels[], std::size_t Stride,
+	std::size_t Width, std::size_t Height,
+	std::size_t WindowHeight, std::uint32_t Averages[]
+)
+{
+	using FormatT = qColorKernel::OrderFormat<Order>;
+	if( WindowHeight == 0 || WindowHeight > Height ) return;
+
+	// Rows are contiguous, so they are summed whole by the SIMD kernel
+	std::vector<qColorSum> Rows(Height);
+	for( std::size_t y = 0; y < Height; ++y )
+	{
+		Rows[y] = qColorKernel::Sum<FormatT>(
+			reinterpret_cast<const std::uint32_t*>(
+				reinterpret_cast<const std::uint8_t*>(Pixels) + y * Stride
+			),
+			Width
+		);
+	}
+
+	qColorSum Window = {};
+	for( std::size_t y = 0; y < WindowHeight; ++y ) Window += Rows[y];
+	Averages[0] = qColorKernel::PackAverageRGBA8(Window);
+	for( std::size_t y = WindowHeight; y < Height; ++y )
+	{
+		Window += Rows[y];
+		Window -= Rows[y - WindowHeight];
+		Averages[y - WindowHeight + 1] = qColorKernel::PackAverageRGBA8(Window);
+	}
+}
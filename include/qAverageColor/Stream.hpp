@@ -0,0 +1,89 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "Types.hpp"
+#include "Kernel.hpp"
+
+// Incremental averaging of pixels that arrive a piece at a time, such as the
+// scanlines of a decoder or the blocks of a file read. Only the running sums
+// are kept, so memory use is independent of the size of the image.
+//
+// qColorStream<qChannelOrder::RGBA> Stream;
+// while( ReadRow(Row) ) Stream.Push(Row, Width);
+// const std::uint32_t Average = Stream.Average();
+template< qChannelOrder Order = qChannelOrder::RGBA >
+class qColorStream
+{
+public:
+	// Whole pixels
+	void Push( const std::uint32_t Pixels[], std::size_t Count )
+	{
+		Total += qColorKernel::Sum<qColorKernel::OrderFormat<Order>>(
+			Pixels, Count
+		);
+	}
+
+	// Arbitrary chunks of bytes with no alignment requirement. A pixel split
+	// across two chunks is held back until its remaining bytes arrive
+	void PushBytes( const void* Data, std::size_t Size )
+	{
+		const std::uint8_t* Bytes = static_cast<const std::uint8_t*>(Data);
+
+		// Finish off the pixel left over from the previous chunk
+		if( PartialSize != 0 )
+		{
+			const std::size_t Fill = Size < 4 - PartialSize ? Size : 4 - PartialSize;
+			std::memcpy(&Partial[PartialSize], Bytes, Fill);
+			PartialSize += Fill;
+			Bytes += Fill;
+			Size  -= Fill;
+			if( PartialSize < 4 ) return;
+			std::uint32_t Pixel;
+			std::memcpy(&Pixel, Partial, sizeof(std::uint32_t));
+			Push(&Pixel, 1);
+			PartialSize = 0;
+		}
+
+		// Whole groups of four pixels go straight to the kernel, which only
+		// ever uses unaligned loads. The last few pixels are copied out one at
+		// a time, so that no std::uint32_t is ever read misaligned
+		const std::size_t Count = Size / 4;
+		const std::size_t Direct = Count & ~std::size_t(3);
+		Push(reinterpret_cast<const std::uint32_t*>(Bytes), Direct);
+		for( std::size_t i = Direct; i < Count; ++i )
+		{
+			std::uint32_t Pixel;
+			std::memcpy(&Pixel, &Bytes[i * 4], sizeof(std::uint32_t));
+			Push(&Pixel, 1);
+		}
+
+		// Hold on to the trailing bytes of a split pixel
+		PartialSize = Size % 4;
+		std::memcpy(Partial, &Bytes[Count * 4], PartialSize);
+	}
+
+	// Sums of all the whole pixels pushed so far
+	const qColorSum& Sum() const
+	{
+		return Total;
+	}
+
+	// Average of all the whole pixels pushed so far, in RGBA order
+	std::uint32_t Average() const
+	{
+		return qColorKernel::PackAverageRGBA8(Total);
+	}
+
+	void Reset()
+	{
+		Total = qColorSum{};
+		PartialSize = 0;
+	}
+
+private:
+	qColorSum Total = {};
+	std::uint8_t Partial[4] = {};
+	std::size_t PartialSize = 0;
+};
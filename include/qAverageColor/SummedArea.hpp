@@ -0,0 +1,276 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include <immintrin.h>
+
+#include "Types.hpp"
+#include "Kernel.hpp"
+
+// Summed-area table(integral image) of the channel sums of an image, after
+// which the sum or average of any rectangle is four lookups no matter how
+// large the rectangle is.
+//
+// Entry (x, y) holds the four channel sums of every pixel above and to the
+// left of pixel (x, y), side by side as one SIMD vector. An extra row and
+// column of zeros along the top and left edges keep the lookups branch-free.
+//
+// SumT is the width of the sums
+//  - std::uint32_t: 16 bytes per entry. The sums wrap around, but a
+//    rectangle's sum is a difference of entries, which is still exact in
+//    modular arithmetic for as long as the rectangle's own sums fit in 32
+//    bits: 0xFFFFFFFF / 0xFF pixels, rectangles of up to 16.8 megapixels
+//  - std::uint64_t: 32 bytes per entry, exact for any rectangle
+template< qChannelOrder Order = qChannelOrder::RGBA, typename SumT = std::uint32_t >
+class qSummedAreaTable
+{
+	static_assert(
+		std::is_same<SumT, std::uint32_t>::value
+		|| std::is_same<SumT, std::uint64_t>::value,
+		"Sums are either 32 or 64 bits"
+	);
+	using FormatT = qColorKernel::OrderFormat<Order>;
+
+public:
+	qSummedAreaTable() = default;
+
+	// Stride is in bytes
+	qSummedAreaTable(
+		const std::uint32_t Pixels[], std::size_t Stride,
+		std::size_t Width, std::size_t Height
+	)
+	{
+		Build(Pixels, Stride, Width, Height);
+	}
+
+	void Build(
+		const std::uint32_t Pixels[], std::size_t Stride,
+		std::size_t Width, std::size_t Height
+	)
+	{
+		this->Width  = Width;
+		this->Height = Height;
+		const std::size_t RowEntries = (Width + 1) * 4;
+		Table.assign(RowEntries * (Height + 1), 0);
+
+		// | ABGR | -> | 000A | 000B | 000G | 000R |
+		// X channels shuffle in zeros
+		const __m128i Widen = qColorKernel::LoadShuffle(WidenTable);
+		// | ABGRABGRABGRABGR | -> | ABGRABGRABGRABGR |
+		// Four pixels in RGBA order, X channels zeroed, ready to be widened
+		const __m128i Reorder = qColorKernel::LoadShuffle(ReorderTable);
+		for( std::size_t y = 0; y < Height; ++y )
+		{
+			const std::uint32_t* Row = reinterpret_cast<const std::uint32_t*>(
+				reinterpret_cast<const std::uint8_t*>(Pixels) + y * Stride
+			);
+			const SumT* Above = &Table[y * RowEntries + 4];
+			SumT* Current = &Table[(y + 1) * RowEntries + 4];
+			std::size_t x = 0;
+			// Running sums of this row so far, added onto the entry above
+			if constexpr( std::is_same<SumT, std::uint32_t>::value )
+			{
+				// Two entries per register, four pixels at a time. Each register
+				// is prefix-summed with a lane-shifted copy of itself, the upper
+				// register picks up the lower one's total, and both pick up the
+				// row so far. Only that add and the broadcast of the new total carry
+				// from one step to the next
+				// |   Pixel1    | Pixel0 |
+				// |   Pixel0    |   0    | +
+				// | Pixel0 + 1  | Pixel0 |
+				__m256i RowSum = _mm256_setzero_si256();
+				for( ; x + 4 <= Width; x += 4 )
+				{
+					const __m128i Quad = _mm_shuffle_epi8(
+						_mm_loadu_si128((const __m128i*)&Row[x]), Reorder
+					);
+					__m256i Lower = _mm256_cvtepu8_epi32(Quad);
+					__m256i Upper = _mm256_cvtepu8_epi32(_mm_srli_si128(Quad, 8));
+					Lower = _mm256_add_epi32(
+						Lower, _mm256_permute2x128_si256(Lower, Lower, 0x08)
+					);
+					Upper = _mm256_add_epi32(
+						Upper, _mm256_permute2x128_si256(Upper, Upper, 0x08)
+					);
+					Upper = _mm256_add_epi32(
+						Upper, _mm256_permute4x64_epi64(Lower, _MM_SHUFFLE(3, 2, 3, 2))
+					);
+					Lower = _mm256_add_epi32(Lower, RowSum);
+					Upper = _mm256_add_epi32(Upper, RowSum);
+					RowSum = _mm256_permute4x64_epi64(Upper, _MM_SHUFFLE(3, 2, 3, 2));
+					_mm256_storeu_si256(
+						(__m256i*)&Current[x * 4],
+						_mm256_add_epi32(
+							Lower, _mm256_loadu_si256((const __m256i*)&Above[x * 4])
+						)
+					);
+					_mm256_storeu_si256(
+						(__m256i*)&Current[x * 4 + 8],
+						_mm256_add_epi32(
+							Upper, _mm256_loadu_si256((const __m256i*)&Above[x * 4 + 8])
+						)
+					);
+				}
+
+				// | ASum32 | BSum32 | GSum32 | RSum32 |
+				__m128i Sum = _mm256_castsi256_si128(RowSum);
+				for( ; x < Width; ++x )
+				{
+					Sum = _mm_add_epi32(
+						Sum, _mm_shuffle_epi8(_mm_cvtsi32_si128(Row[x]), Widen)
+					);
+					_mm_storeu_si128(
+						(__m128i*)&Current[x * 4],
+						_mm_add_epi32(
+							Sum, _mm_loadu_si128((const __m128i*)&Above[x * 4])
+						)
+					);
+				}
+			}
+			else
+			{
+				// One entry per register, four pixels at a time. The four are
+				// prefix-summed among themselves as two pairs, so that only one
+				// add per step carries the row so far from one step to the next
+				// | ASum64 | BSum64 | GSum64 | RSum64 |
+				__m256i RowSum = _mm256_setzero_si256();
+				for( ; x + 4 <= Width; x += 4 )
+				{
+					const __m128i Quad = _mm_shuffle_epi8(
+						_mm_loadu_si128((const __m128i*)&Row[x]), Reorder
+					);
+					const __m256i Pixel0 = _mm256_cvtepu8_epi64(Quad);
+					const __m256i Pixel1 = _mm256_cvtepu8_epi64(_mm_srli_si128(Quad,  4));
+					const __m256i Pixel2 = _mm256_cvtepu8_epi64(_mm_srli_si128(Quad,  8));
+					const __m256i Pixel3 = _mm256_cvtepu8_epi64(_mm_srli_si128(Quad, 12));
+					const __m256i Sum1 = _mm256_add_epi64(Pixel0, Pixel1);
+					const __m256i Sum3 = _mm256_add_epi64(
+						Sum1, _mm256_add_epi64(Pixel2, Pixel3)
+					);
+					const auto Store = [&]( std::size_t i, __m256i Sum )
+					{
+						_mm256_storeu_si256(
+							(__m256i*)&Current[(x + i) * 4],
+							_mm256_add_epi64(
+								_mm256_add_epi64(Sum, RowSum),
+								_mm256_loadu_si256((const __m256i*)&Above[(x + i) * 4])
+							)
+						);
+					};
+					Store(0, Pixel0);
+					Store(1, Sum1);
+					Store(2, _mm256_add_epi64(Sum1, Pixel2));
+					Store(3, Sum3);
+					RowSum = _mm256_add_epi64(RowSum, Sum3);
+				}
+
+				for( ; x < Width; ++x )
+				{
+					RowSum = _mm256_add_epi64(
+						RowSum,
+						_mm256_cvtepu32_epi64(
+							_mm_shuffle_epi8(_mm_cvtsi32_si128(Row[x]), Widen)
+						)
+					);
+					_mm256_storeu_si256(
+						(__m256i*)&Current[x * 4],
+						_mm256_add_epi64(
+							RowSum, _mm256_loadu_si256((const __m256i*)&Above[x * 4])
+						)
+					);
+				}
+			}
+		}
+	}
+
+	// Sums of a rectangle that lies within the image
+	qColorSum Sum( const qRect& Rect ) const
+	{
+		const std::size_t RowEntries = (Width + 1) * 4;
+		const SumT* Top    = &Table[Rect.Y * RowEntries];
+		const SumT* Bottom = &Table[(Rect.Y + Rect.Height) * RowEntries];
+		const std::size_t Left  = Rect.X * 4;
+		const std::size_t Right = (Rect.X + Rect.Width) * 4;
+
+		// Bottom-right - Top-right - Bottom-left + Top-left
+		qColorSum RectSum;
+		if constexpr( std::is_same<SumT, std::uint32_t>::value )
+		{
+			const __m128i Sum32 = _mm_add_epi32(
+				_mm_sub_epi32(
+					_mm_loadu_si128((const __m128i*)&Bottom[Right]),
+					_mm_loadu_si128((const __m128i*)&Top[Right])
+				),
+				_mm_sub_epi32(
+					_mm_loadu_si128((const __m128i*)&Top[Left]),
+					_mm_loadu_si128((const __m128i*)&Bottom[Left])
+				)
+			);
+			RectSum.Red   = static_cast<std::uint32_t>(_mm_cvtsi128_si32(Sum32));
+			RectSum.Green = static_cast<std::uint32_t>(_mm_extract_epi32(Sum32, 1));
+			RectSum.Blue  = static_cast<std::uint32_t>(_mm_extract_epi32(Sum32, 2));
+			RectSum.Alpha = static_cast<std::uint32_t>(_mm_extract_epi32(Sum32, 3));
+		}
+		else
+		{
+			const __m256i Sum64 = _mm256_add_epi64(
+				_mm256_sub_epi64(
+					_mm256_loadu_si256((const __m256i*)&Bottom[Right]),
+					_mm256_loadu_si256((const __m256i*)&Top[Right])
+				),
+				_mm256_sub_epi64(
+					_mm256_loadu_si256((const __m256i*)&Top[Left]),
+					_mm256_loadu_si256((const __m256i*)&Bottom[Left])
+				)
+			);
+			RectSum.Red   = _mm256_extract_epi64(Sum64, 0);
+			RectSum.Green = _mm256_extract_epi64(Sum64, 1);
+			RectSum.Blue  = _mm256_extract_epi64(Sum64, 2);
+			RectSum.Alpha = _mm256_extract_epi64(Sum64, 3);
+		}
+		RectSum.Count = std::uint64_t(Rect.Width) * Rect.Height;
+		// Pixels without an alpha channel are opaque
+		if constexpr( FormatT::Padded )
+		{
+			RectSum.Alpha = RectSum.Count * 0xFF;
+		}
+		return RectSum;
+	}
+
+	// Average of a rectangle that lies within the image, in RGBA order
+	std::uint32_t Average( const qRect& Rect ) const
+	{
+		return qColorKernel::PackAverageRGBA8(Sum(Rect));
+	}
+
+private:
+	static constexpr qColorKernel::ShuffleTable WidenTable = {{
+		qColorKernel::ShuffleIndex(FormatT::Red,   0), -1, -1, -1,
+		qColorKernel::ShuffleIndex(FormatT::Green, 0), -1, -1, -1,
+		qColorKernel::ShuffleIndex(FormatT::Blue,  0), -1, -1, -1,
+		qColorKernel::ShuffleIndex(FormatT::Alpha, 0), -1, -1, -1
+	}};
+	static constexpr qColorKernel::ShuffleTable ReorderTable = {{
+		qColorKernel::ShuffleIndex(FormatT::Red,   0),
+		qColorKernel::ShuffleIndex(FormatT::Green, 0),
+		qColorKernel::ShuffleIndex(FormatT::Blue,  0),
+		qColorKernel::ShuffleIndex(FormatT::Alpha, 0),
+		qColorKernel::ShuffleIndex(FormatT::Red,   1),
+		qColorKernel::ShuffleIndex(FormatT::Green, 1),
+		qColorKernel::ShuffleIndex(FormatT::Blue,  1),
+		qColorKernel::ShuffleIndex(FormatT::Alpha, 1),
+		qColorKernel::ShuffleIndex(FormatT::Red,   2),
+		qColorKernel::ShuffleIndex(FormatT::Green, 2),
+		qColorKernel::ShuffleIndex(FormatT::Blue,  2),
+		qColorKernel::ShuffleIndex(FormatT::Alpha, 2),
+		qColorKernel::ShuffleIndex(FormatT::Red,   3),
+		qColorKernel::ShuffleIndex(FormatT::Green, 3),
+		qColorKernel::ShuffleIndex(FormatT::Blue,  3),
+		qColorKernel::ShuffleIndex(FormatT::Alpha, 3)
+	}};
+
+	std::size_t Width = 0, Height = 0;
+	std::vector<SumT> Table;
+};
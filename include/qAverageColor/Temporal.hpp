@@ -0,0 +1,197 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+#include "Types.hpp"
+#include "Kernel.hpp"
+
+// Running average across the frames of a video. Rather than averaging the
+// per-frame averages, which rounds every frame, the exact 64-bit sums of
+// every frame are kept and divided only when the average is read.
+//
+// With a Decay below 1, older frames fade out exponentially: the running sums
+// are scaled by Decay before each new frame is added, so a frame that is n
+// frames old has a weight of Decay^n. The weights apply to the sums and the
+// pixel count alike, so they cancel out of the average. Decay is kept in
+// 0.16 fixed-point and the decayed sums in 56.8 fixed-point, so the rounding
+// of each scaling stays far below a unit of the sums it settles into.
+template< qChannelOrder Order = qChannelOrder::RGBA >
+class qTemporalColorSum
+{
+public:
+	// Decay, in 1/65536ths
+	static constexpr std::uint32_t DecayBits = 16;
+	static constexpr std::uint32_t DecayOne = 1u << DecayBits;
+	// Fractional bits of the decayed sums
+	static constexpr std::uint32_t SumBits = 8;
+
+	// Decay of 1.0 keeps every frame at full weight, forever. The exact sums
+	// then last for 2^64 / (255 * Count) frames of Count pixels, a few billion
+	// frames of 8K video.
+	// Any other Decay is rounded to 1/65536ths, to at most 65535/65536, so the
+	// decayed sums settle at no more than 65536 frames' worth. With 56 integer
+	// bits, they stay within 64 bits for frames of up to 2^32 pixels
+	explicit qTemporalColorSum( double Decay = 1.0 )
+	: Decay(
+		Decay >= 1.0 ? DecayOne
+		: !(Decay > 0.0) ? 0u
+		: std::min<std::uint32_t>(
+			static_cast<std::uint32_t>(Decay * DecayOne + 0.5), DecayOne - 1
+		)
+	)
+	{
+	}
+
+	void AddFrame( const std::uint32_t Pixels[], std::size_t Count )
+	{
+		AddFrame(
+			qColorKernel::Sum<qColorKernel::OrderFormat<Order>>(Pixels, Count)
+		);
+	}
+
+	// Adds the sums of a frame that were summed elsewhere
+	void AddFrame( const qColorSum& Frame )
+	{
+		if( Decay == DecayOne )
+		{
+			Total += Frame;
+			return;
+		}
+		Decayed.Red   = Scale(Decayed.Red)   + (Frame.Red   << SumBits);
+		Decayed.Green = Scale(Decayed.Green) + (Frame.Green << SumBits);
+		Decayed.Blue  = Scale(Decayed.Blue)  + (Frame.Blue  << SumBits);
+		Decayed.Alpha = Scale(Decayed.Alpha) + (Frame.Alpha << SumBits);
+		Decayed.Count = Scale(Decayed.Count) + (Frame.Count << SumBits);
+	}
+
+	// Weighted sums of all frames so far. Exact when there is no decay
+	qColorSum Sum() const
+	{
+		if( Decay == DecayOne ) return Total;
+		constexpr std::uint64_t Half = 1ull << (SumBits - 1);
+		return {
+			(Decayed.Red   + Half) >> SumBits,
+			(Decayed.Green + Half) >> SumBits,
+			(Decayed.Blue  + Half) >> SumBits,
+			(Decayed.Alpha + Half) >> SumBits,
+			(Decayed.Count + Half) >> SumBits
+		};
+	}
+
+	// Average of all frames so far, in RGBA order
+	std::uint32_t Average() const
+	{
+		if( Decay == DecayOne ) return qColorKernel::PackAverageRGBA8(Total);
+		if( Decayed.Count == 0 ) return 0;
+		// The fractional bits cancel out of the division. Rounded to the
+		// nearest value, as the scaled sums are rounded too and a flat color
+		// should not truncate to one below itself
+		const auto Channel = [this]( std::uint64_t ChannelSum ) -> std::uint32_t
+		{
+			return static_cast<std::uint32_t>(std::min<std::uint64_t>(
+				(ChannelSum + Decayed.Count / 2) / Decayed.Count, 0xFF
+			));
+		};
+		return
+			(Channel(Decayed.Alpha) << 24) | (Channel(Decayed.Blue) << 16) |
+			(Channel(Decayed.Green) <<  8) | (Channel(Decayed.Red)  <<  0);
+	}
+
+	void Reset()
+	{
+		Total   = qColorSum{};
+		Decayed = qColorSum{};
+	}
+
+private:
+	// Value * Decay / 65536, rounded to nearest. The product takes up to 80
+	// bits, so it is done at 128 bits
+	std::uint64_t Scale( std::uint64_t Value ) const
+	{
+#if defined(_MSC_VER) && !defined(__clang__)
+		std::uint64_t High;
+		std::uint64_t Low = _umul128(Value, Decay, &High);
+		Low += DecayOne / 2;
+		High += Low < DecayOne / 2;
+		return (High << (64 - DecayBits)) | (Low >> DecayBits);
+#else
+		return static_cast<std::uint64_t>(
+			(static_cast<unsigned __int128>(Value) * Decay + DecayOne / 2) >> DecayBits
+		);
+#endif
+	}
+
+	const std::uint32_t Decay;
+	// Exact sums, while Decay is DecayOne
+	qColorSum Total = {};
+	// Decayed sums in 56.8 fixed-point, otherwise
+	qColorSum Decayed = {};
+};
+
+// Running average of only the last FrameCount frames, a box window over time.
+// The sums of the frames in the window are kept, so each new frame adds its
+// own sums and subtracts those of the frame that falls out of the window.
+template< qChannelOrder Order = qChannelOrder::RGBA >
+class qSlidingColorSum
+{
+public:
+	explicit qSlidingColorSum( std::size_t FrameCount )
+	: Frames(FrameCount ? FrameCount : 1)
+	{
+	}
+
+	void AddFrame( const std::uint32_t Pixels[], std::size_t Count )
+	{
+		AddFrame(
+			qColorKernel::Sum<qColorKernel::OrderFormat<Order>>(Pixels, Count)
+		);
+	}
+
+	// Adds the sums of a frame that were summed elsewhere
+	void AddFrame( const qColorSum& Frame )
+	{
+		if( Filled == Frames.size() )
+		{
+			Total -= Frames[Next];
+		}
+		else
+		{
+			++Filled;
+		}
+		Frames[Next] = Frame;
+		Total += Frame;
+		Next = (Next + 1) % Frames.size();
+	}
+
+	// Sums of the frames within the window
+	qColorSum Sum() const
+	{
+		return Total;
+	}
+
+	// Average of the frames within the window, in RGBA order
+	std::uint32_t Average() const
+	{
+		return qColorKernel::PackAverageRGBA8(Total);
+	}
+
+	void Reset()
+	{
+		Total  = qColorSum{};
+		Next   = 0;
+		Filled = 0;
+	}
+
+private:
+	// Ring of the sums of the last FrameCount frames, oldest at Next
+	std::vector<qColorSum> Frames;
+	std::size_t Next   = 0;
+	std::size_t Filled = 0;
+	qColorSum Total = {};
+};
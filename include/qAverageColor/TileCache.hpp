@@ -0,0 +1,123 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Types.hpp"
+#include "Kernel.hpp"
+
+// Cached average of a surface that changes a few rectangles at a time, such
+// as a window surface of a compositor. The surface is split into tiles and
+// the sums of every tile are kept, along with their total. Only the tiles that
+// a dirty rectangle touches are summed again, so an update costs time
+// proportional to the damaged area rather than to the whole surface.
+//
+// qTiledColorSum<qChannelOrder::BGRA> Surface(Width, Height);
+// Surface.Update(Pixels, Stride);                   // Once, everything
+// Surface.Update(Pixels, Stride, Damage, DamageCount); // Every frame
+// const std::uint32_t Average = Surface.Average();
+template< qChannelOrder Order = qChannelOrder::RGBA >
+class qTiledColorSum
+{
+public:
+	// Tiles are TileSize x TileSize pixels, the default is a 16KiB tile of
+	// 64 rows of 64 pixels
+	qTiledColorSum(
+		std::size_t Width, std::size_t Height, std::size_t TileSize = 64
+	)
+	: Width(Width), Height(Height), TileSize(TileSize ? TileSize : 64),
+	TilesX((Width + this->TileSize - 1) / this->TileSize),
+	TilesY((Height + this->TileSize - 1) / this->TileSize),
+	Tiles(TilesX * TilesY), Dirty(TilesX * TilesY, false)
+	{
+	}
+
+	// Sums every tile of the surface. Stride is in bytes
+	void Update( const std::uint32_t Pixels[], std::size_t Stride )
+	{
+		Total = qColorSum{};
+		for( std::size_t Tile = 0; Tile < Tiles.size(); ++Tile )
+		{
+			Tiles[Tile] = SumTile(Pixels, Stride, Tile);
+			Total += Tiles[Tile];
+		}
+	}
+
+	// Sums just the tiles that any of the dirty rectangles touch. Rectangles
+	// are clipped to the surface and may overlap each other
+	void Update(
+		const std::uint32_t Pixels[], std::size_t Stride,
+		const qRect DirtyRects[], std::size_t DirtyCount
+	)
+	{
+		DirtyTiles.clear();
+		for( std::size_t i = 0; i < DirtyCount; ++i )
+		{
+			const qRect& Rect = DirtyRects[i];
+			if( Rect.X >= Width || Rect.Y >= Height ) continue;
+			if( Rect.Width == 0 || Rect.Height == 0 ) continue;
+			const std::size_t Right  = Rect.Width  < Width  - Rect.X ? Rect.X + Rect.Width  : Width;
+			const std::size_t Bottom = Rect.Height < Height - Rect.Y ? Rect.Y + Rect.Height : Height;
+			for( std::size_t y = Rect.Y / TileSize; y <= (Bottom - 1) / TileSize; ++y )
+			{
+				for( std::size_t x = Rect.X / TileSize; x <= (Right - 1) / TileSize; ++x )
+				{
+					const std::size_t Tile = y * TilesX + x;
+					if( Dirty[Tile] ) continue;
+					Dirty[Tile] = true;
+					DirtyTiles.push_back(Tile);
+				}
+			}
+		}
+		for( const std::size_t Tile : DirtyTiles )
+		{
+			Total -= Tiles[Tile];
+			Tiles[Tile] = SumTile(Pixels, Stride, Tile);
+			Total += Tiles[Tile];
+			Dirty[Tile] = false;
+		}
+	}
+
+	const qColorSum& Sum() const
+	{
+		return Total;
+	}
+
+	// Average of the whole surface, in RGBA order
+	std::uint32_t Average() const
+	{
+		return qColorKernel::PackAverageRGBA8(Total);
+	}
+
+	// Sums of a single tile, tiles are numbered in row-major order
+	const qColorSum& TileSum( std::size_t TileX, std::size_t TileY ) const
+	{
+		return Tiles[TileY * TilesX + TileX];
+	}
+
+private:
+	qColorSum SumTile(
+		const std::uint32_t Pixels[], std::size_t Stride, std::size_t Tile
+	) const
+	{
+		const std::size_t x = (Tile % TilesX) * TileSize;
+		const std::size_t y = (Tile / TilesX) * TileSize;
+		return qColorKernel::SumRect<qColorKernel::OrderFormat<Order>>(
+			reinterpret_cast<const std::uint32_t*>(
+				reinterpret_cast<const std::uint8_t*>(Pixels) + y * Stride
+			) + x,
+			Stride,
+			TileSize < Width  - x ? TileSize : Width  - x,
+			TileSize < Height - y ? TileSize : Height - y
+		);
+	}
+
+	const std::size_t Width, Height;
+	const std::size_t TileSize;
+	const std::size_t TilesX, TilesY;
+	std::vector<qColorSum> Tiles;
+	qColorSum Total = {};
+	// Scratch space of Update, kept around to save reallocating it
+	std::vector<bool> Dirty;
+	std::vector<std::size_t> DirtyTiles;
+};
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Per-channel sums of a set of pixels, and how many pixels were summed
+struct qColorSum
+{
+	std::uint64_t Red, Green, Blue, Alpha;
+	std::uint64_t Count;
+
+	// Sums of disjoint sets of pixels merge into the sum of their union
+	qColorSum& operator+=( const qColorSum& Other )
+	{
+		Red   += Other.Red;
+		Green += Other.Green;
+		Blue  += Other.Blue;
+		Alpha += Other.Alpha;
+		Count += Other.Count;
+		return *this;
+	}
+
+	// Removes the sum of a subset of the pixels
+	qColorSum& operator-=( const qColorSum& Other )
+	{
+		Red   -= Other.Red;
+		Green -= Other.Green;
+		Blue  -= Other.Blue;
+		Alpha -= Other.Alpha;
+		Count -= Other.Count;
+		return *this;
+	}
+};
+
+// Estimate of the average of a set of pixels, from a sample of them
+struct qColorEstimate
+{
+	// Estimated sums of all of the pixels, as though every pixel was read
+	qColorSum Sum;
+	// Average of the estimated sums, in RGBA order
+	std::uint32_t Average;
+	// Half-width of the 95% confidence interval of each channel's average, in
+	// 8-bit units. 0 when every pixel was read
+	float RedError, GreenError, BlueError, AlphaError;
+	// How many pixels were actually read
+	std::uint64_t SampleCount;
+};
+
+// Rectangle of pixels, in pixels
+struct qRect
+{
+	std::size_t X, Y;
+	std::size_t Width, Height;
+};
+
+// Byte order of a 32-bit pixel in memory. X is an unused padding byte that is
+// never summed, such pixels are treated as opaque.
+// Windows' BGRA surfaces and Cairo's native-endian ARGB32 are both BGRA on
+// little-endian hosts
+enum class qChannelOrder
+{
+	RGBA,
+	BGRA,
+	ARGB,
+	ABGR,
+	RGBX,
+	BGRX,
+	XRGB,
+	XBGR
+};
+
+// How the pixels of a scan are brought into the cache
+enum class qCacheHint
+{
+	// Ordinary loads, the pixels stay cached for whoever reads them next
+	Normal,
+	// The pixels are prefetched with prefetchnta, which keeps them out of
+	// most of the cache hierarchy so that scanning a buffer much larger than
+	// the last-level cache does not evict the working sets of other cores
+	NonTemporal
+};
+
+struct qCachePolicy
+{
+	// Used by NonTemporal when no distance is given. prefetchnta has to run
+	// far enough ahead to cover the latency of DRAM on its own
+	static constexpr std::size_t DefaultNonTemporalDistance = 2048;
+
+	qCacheHint Hint = qCacheHint::Normal;
+	// Software-prefetch this many bytes ahead of the loads. 0 leaves it to
+	// the hardware prefetchers
+	std::size_t PrefetchDistance = 0;
+	// Rectangle and batch sums: how many rows or images ahead to prefetch the
+	// start of, where the hardware prefetchers lose track of the access
+	// pattern. 0 disables
+	std::size_t PrefetchAhead = 0;
+};
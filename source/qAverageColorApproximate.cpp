@@ -0,0 +1,163 @@
+#include <qAverageColor.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+// Blocks of 4KiB, so that every sampled block is one page of sequential loads
+// for the hardware prefetchers
+constexpr std::size_t BlockPixels = 1024;
+
+// Two-sided 95% confidence interval of a normal distribution
+constexpr double ConfidenceZ = 1.96;
+
+// SplitMix64, small and good enough to pick blocks with
+std::uint64_t NextRandom( std::uint64_t& State )
+{
+	std::uint64_t Z = (State += 0x9E3779B97F4A7C15);
+	Z = (Z ^ (Z >> 30)) * 0xBF58476D1CE4E5B9;
+	Z = (Z ^ (Z >> 27)) * 0x94D049BB133111EB;
+	return Z ^ (Z >> 31);
+}
+
+// Estimates the average of BlockCount blocks of BlockSize pixels each, plus the
+// Exact sums of any pixels that are not part of a block. Block(Index) is the
+// address of a block's first pixel
+//
+// The blocks are split into as many even strata as there are samples, and one
+// block is picked at random from each stratum, so the sample is spread across
+// the whole image rather than clumping up. The error bound treats the sampled
+// block averages as a simple random sample, with the finite population
+// correction: stratification only ever makes the true error smaller
+template< typename BlockT >
+qColorEstimate Estimate(
+	std::size_t BlockCount, std::size_t BlockSize, const qColorSum& Exact,
+	double Fraction, std::uint32_t Seed, BlockT&& Block
+)
+{
+	qColorEstimate Result = {};
+	// A NaN Fraction reads as little as a Fraction of 0
+	const double Clamped = Fraction > 0.0 ? std::min(Fraction, 1.0) : 0.0;
+	const std::size_t Samples = std::clamp<std::size_t>(
+		static_cast<std::size_t>(std::ceil(Clamped * BlockCount)),
+		std::min<std::size_t>(2, BlockCount), BlockCount
+	);
+
+	std::uint64_t State = Seed;
+	const auto PickBlock = [&]( std::size_t Stratum ) -> std::size_t
+	{
+		const std::size_t First = Stratum * BlockCount / Samples;
+		const std::size_t Last  = (Stratum + 1) * BlockCount / Samples;
+		return First + NextRandom(State) % (Last - First);
+	};
+
+	qColorSum Sampled = {};
+	// Running mean and sum of squared deviations of the block averages
+	// (Welford), for each channel
+	double Mean[4] = {}, Deviation[4] = {};
+	std::size_t Next = Samples ? PickBlock(0) : 0;
+	for( std::size_t i = 0; i < Samples; ++i )
+	{
+		const std::uint32_t* Pixels = Block(Next);
+		// The next block is somewhere else entirely, which the hardware
+		// prefetchers can not guess at
+		if( i + 1 < Samples )
+		{
+			Next = PickBlock(i + 1);
+			qColorKernel::PrefetchAhead(
+				Block(Next), BlockSize * sizeof(std::uint32_t), qCacheHint::Normal
+			);
+		}
+		const qColorSum BlockSum = qColorKernel::Sum<
+			qColorKernel::OrderFormat<qChannelOrder::RGBA>
+		>(Pixels, BlockSize);
+		Sampled += BlockSum;
+
+		const double Average[4] = {
+			double(BlockSum.Red)   / BlockSize, double(BlockSum.Green) / BlockSize,
+			double(BlockSum.Blue)  / BlockSize, double(BlockSum.Alpha) / BlockSize
+		};
+		for( std::size_t Channel = 0; Channel < 4; ++Channel )
+		{
+			const double Delta = Average[Channel] - Mean[Channel];
+			Mean[Channel] += Delta / double(i + 1);
+			Deviation[Channel] += Delta * (Average[Channel] - Mean[Channel]);
+		}
+	}
+
+	// Scale the sampled blocks up to all of the blocks
+	const std::uint64_t BlockTotal = std::uint64_t(BlockCount) * BlockSize;
+	const double Scale = Samples ? double(BlockCount) / double(Samples) : 0.0;
+	Result.Sum = Exact;
+	if( Samples == BlockCount )
+	{
+		Result.Sum += Sampled;
+	}
+	else
+	{
+		Result.Sum.Red   += std::uint64_t(std::llround(Sampled.Red   * Scale));
+		Result.Sum.Green += std::uint64_t(std::llround(Sampled.Green * Scale));
+		Result.Sum.Blue  += std::uint64_t(std::llround(Sampled.Blue  * Scale));
+		Result.Sum.Alpha += std::uint64_t(std::llround(Sampled.Alpha * Scale));
+		Result.Sum.Count += BlockTotal;
+
+		// Standard error of the mean of the block averages, weighted by how
+		// much of the image is made up of blocks
+		const double Correction = 1.0 - double(Samples) / double(BlockCount);
+		const double Weight = double(BlockTotal) / double(Result.Sum.Count);
+		float* Errors[4] = {
+			&Result.RedError, &Result.GreenError, &Result.BlueError, &Result.AlphaError
+		};
+		for( std::size_t Channel = 0; Channel < 4; ++Channel )
+		{
+			const double Variance = Deviation[Channel] / double(Samples - 1);
+			*Errors[Channel] = static_cast<float>(
+				ConfidenceZ * Weight * std::sqrt(Correction * Variance / double(Samples))
+			);
+		}
+	}
+	Result.Average     = qColorKernel::PackAverageRGBA8(Result.Sum);
+	Result.SampleCount = Sampled.Count + Exact.Count;
+	return Result;
+}
+
+}
+
+qColorEstimate qAverageColorRGBA8Approximate(
+	const std::uint32_t Pixels[], std::size_t Count,
+	double Fraction, std::uint32_t Seed
+)
+{
+	const std::size_t BlockCount = Count / BlockPixels;
+	// The pixels past the last whole block are always read
+	const qColorSum Tail = qColorKernel::Sum<
+		qColorKernel::OrderFormat<qChannelOrder::RGBA>
+	>(Pixels + BlockCount * BlockPixels, Count % BlockPixels);
+	return Estimate(
+		BlockCount, BlockPixels, Tail, Fraction, Seed,
+		[&]( std::size_t Index ) -> const std::uint32_t*
+		{
+			return Pixels + Index * BlockPixels;
+		}
+	);
+}
+
+qColorEstimate qAverageColorRGBA8RectApproximate(
+	const std::uint32_t Pixels[], std::size_t Stride,
+	std::size_t Width, std::size_t Height,
+	double Fraction, std::uint32_t Seed
+)
+{
+	if( Width == 0 ) return qColorEstimate{};
+	return Estimate(
+		Height, Width, qColorSum{}, Fraction, Seed,
+		[&]( std::size_t Index ) -> const std::uint32_t*
+		{
+			return reinterpret_cast<const std::uint32_t*>(
+				reinterpret_cast<const std::uint8_t*>(Pixels) + Index * Stride
+			);
+		}
+	);
+}
@@ -0,0 +1,165 @@
+#include <qAverageColor.hpp>
+
+#include <immintrin.h>
+
+namespace
+{
+
+// Kahan-compensated summation, each lane keeps a running compensation of the
+// low-order bits lost when adding a small value into a large sum. Without it,
+// float sums drift by whole percents over hundreds of millions of pixels.
+// This relies on the compiler not reassociating floating point math, so do
+// not build this file with -ffast-math or /fp:fast.
+#if defined(__AVX512F__)
+inline void KahanAdd( __m512& Sum, __m512& Compensation, __m512 Value )
+{
+	const __m512 Corrected = _mm512_sub_ps(Value, Compensation);
+	const __m512 NewSum = _mm512_add_ps(Sum, Corrected);
+	Compensation = _mm512_sub_ps(_mm512_sub_ps(NewSum, Sum), Corrected);
+	Sum = NewSum;
+}
+#endif
+
+inline void KahanAdd( __m256& Sum, __m256& Compensation, __m256 Value )
+{
+	const __m256 Corrected = _mm256_sub_ps(Value, Compensation);
+	const __m256 NewSum = _mm256_add_ps(Sum, Corrected);
+	Compensation = _mm256_sub_ps(_mm256_sub_ps(NewSum, Sum), Corrected);
+	Sum = NewSum;
+}
+
+// Pixel loaders convert a run of pixels into RGBA32F lanes
+// | A | B | G | R | A | B | G | R | ...
+struct LoadRGBA32F
+{
+	const float* Pixels;
+
+#if defined(__AVX512F__)
+	// 4 pixels
+	__m512 Load4( std::size_t i ) const
+	{
+		return _mm512_loadu_ps(&Pixels[i * 4]);
+	}
+#endif
+	// 2 pixels
+	__m256 Load2( std::size_t i ) const
+	{
+		return _mm256_loadu_ps(&Pixels[i * 4]);
+	}
+	float Load( std::size_t i, std::size_t Channel ) const
+	{
+		return Pixels[i * 4 + Channel];
+	}
+};
+
+struct LoadRGBA16F
+{
+	const std::uint16_t* Pixels;
+
+	// Half-floats are only ever widened with vcvtph2ps(F16C/AVX512F) and never
+	// summed at half precision, an 11-bit mantissa stops accumulating after
+	// just 2048 pixels of 1.0
+#if defined(__AVX512F__)
+	// 4 pixels
+	__m512 Load4( std::size_t i ) const
+	{
+		return qColorKernel::HalfToFloat(
+			_mm256_loadu_si256((const __m256i*)&Pixels[i * 4])
+		);
+	}
+#endif
+	// 2 pixels
+	__m256 Load2( std::size_t i ) const
+	{
+		return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)&Pixels[i * 4]));
+	}
+	float Load( std::size_t i, std::size_t Channel ) const
+	{
+		return _cvtsh_ss(Pixels[i * 4 + Channel]);
+	}
+};
+
+template< typename LoaderT >
+std::array<float, 4> AverageRGBAFloat(
+	const LoaderT& Loader,
+	std::size_t Count
+)
+{
+	if( Count == 0 ) return {};
+
+	std::size_t i = 0;
+	// Final horizontal sums are done at double precision
+	double RGBASum[4] = {};
+
+#if defined(__AVX512F__)
+	// 8 pixels at a time! (AVX512)
+	// Two independent sums to hide the latency of the compensation chain
+	// | A | B | G | R | A | B | G | R | A | B | G | R | A | B | G | R | x2
+	__m512 RGBASumLo = _mm512_setzero_ps(), RGBACompensationLo = _mm512_setzero_ps();
+	__m512 RGBASumHi = _mm512_setzero_ps(), RGBACompensationHi = _mm512_setzero_ps();
+	for( std::size_t j = i/8; j < Count/8; j++, i += 8 )
+	{
+		KahanAdd(RGBASumLo, RGBACompensationLo, Loader.Load4(i + 0));
+		KahanAdd(RGBASumHi, RGBACompensationHi, Loader.Load4(i + 4));
+	}
+	alignas(64) float Lanes[4][16];
+	_mm512_store_ps(Lanes[0], RGBASumLo);
+	_mm512_store_ps(Lanes[1], RGBACompensationLo);
+	_mm512_store_ps(Lanes[2], RGBASumHi);
+	_mm512_store_ps(Lanes[3], RGBACompensationHi);
+	for( std::size_t Lane = 0; Lane < 16; ++Lane )
+	{
+		RGBASum[Lane % 4] += double(Lanes[0][Lane]) - double(Lanes[1][Lane]);
+		RGBASum[Lane % 4] += double(Lanes[2][Lane]) - double(Lanes[3][Lane]);
+	}
+#endif
+	// 2 pixels at a time! (AVX2/F16C)
+	// | A | B | G | R | A | B | G | R |
+	__m256 RGBASum32 = _mm256_setzero_ps(), RGBACompensation = _mm256_setzero_ps();
+	for( std::size_t j = i/2; j < Count/2; j++, i += 2 )
+	{
+		KahanAdd(RGBASum32, RGBACompensation, Loader.Load2(i));
+	}
+	alignas(32) float Lanes32[2][8];
+	_mm256_store_ps(Lanes32[0], RGBASum32);
+	_mm256_store_ps(Lanes32[1], RGBACompensation);
+	for( std::size_t Lane = 0; Lane < 8; ++Lane )
+	{
+		RGBASum[Lane % 4] += double(Lanes32[0][Lane]) - double(Lanes32[1][Lane]);
+	}
+
+	// Serial
+	for( ; i < Count; ++i )
+	{
+		for( std::size_t Channel = 0; Channel < 4; ++Channel )
+		{
+			RGBASum[Channel] += Loader.Load(i, Channel);
+		}
+	}
+
+	// Average
+	return {
+		float(RGBASum[0] / double(Count)),
+		float(RGBASum[1] / double(Count)),
+		float(RGBASum[2] / double(Count)),
+		float(RGBASum[3] / double(Count))
+	};
+}
+
+}
+
+std::array<float, 4> qAverageColorRGBA32F(
+	const float Pixels[],
+	std::size_t Count
+)
+{
+	return AverageRGBAFloat(LoadRGBA32F{Pixels}, Count);
+}
+
+std::array<float, 4> qAverageColorRGBA16F(
+	const std::uint16_t Pixels[],
+	std::size_t Count
+)
+{
+	return AverageRGBAFloat(LoadRGBA16F{Pixels}, Count);
+}
@@ -0,0 +1,361 @@
+#include <qAverageColor.hpp>
+
+#include <immintrin.h>
+
+namespace
+{
+
+// Packed formats are described by the bit-offset and bit-width of each of
+// their R, G, B, A channels within a pixel. A channel of width 0 is absent.
+struct FormatRGB565
+{
+	using PixelT = std::uint16_t;
+	static constexpr std::uint32_t Shift[4] = { 11, 5,  0,  0 };
+	static constexpr std::uint32_t Bits[4]  = {  5, 6,  5,  0 };
+};
+
+struct FormatRGBA4444
+{
+	using PixelT = std::uint16_t;
+	static constexpr std::uint32_t Shift[4] = { 12, 8,  4,  0 };
+	static constexpr std::uint32_t Bits[4]  = {  4, 4,  4,  4 };
+};
+
+struct FormatRGB10A2
+{
+	using PixelT = std::uint32_t;
+	static constexpr std::uint32_t Shift[4] = {  0, 10, 20, 30 };
+	static constexpr std::uint32_t Bits[4]  = { 10, 10, 10,  2 };
+};
+
+template< typename FormatT, std::size_t Channel >
+constexpr std::uint32_t ChannelMask = (1u << FormatT::Bits[Channel]) - 1;
+
+// 16-bit formats: every channel is at most 8 bits, so once it is shifted and
+// masked into the low byte of each 16-bit lane sad_epu8 can sum it straight
+// into a 64-bit accumulator, no overflow-bounded inner loop needed
+// |0C|0C|0C|0C|0C|0C|0C|0C|
+// |      CSum64           |
+#if defined(__AVX512BW__)
+template< typename FormatT, std::size_t Channel >
+inline void SumChannel16( __m512i& ChannelSum64, __m512i Pixels )
+{
+	if constexpr( FormatT::Bits[Channel] == 0 ) return;
+	else
+	{
+		__m512i ChannelWords = _mm512_srli_epi16(Pixels, FormatT::Shift[Channel]);
+		if constexpr( FormatT::Shift[Channel] + FormatT::Bits[Channel] < 16 )
+		{
+			ChannelWords = _mm512_and_si512(
+				ChannelWords,
+				_mm512_set1_epi16(ChannelMask<FormatT, Channel>)
+			);
+		}
+		ChannelSum64 = _mm512_add_epi64(
+			ChannelSum64,
+			_mm512_sad_epu8(ChannelWords, _mm512_setzero_si512())
+		);
+	}
+}
+#endif
+
+template< typename FormatT, std::size_t Channel >
+inline void SumChannel16( __m256i& ChannelSum64, __m256i Pixels )
+{
+	if constexpr( FormatT::Bits[Channel] == 0 ) return;
+	else
+	{
+		__m256i ChannelWords = _mm256_srli_epi16(Pixels, FormatT::Shift[Channel]);
+		if constexpr( FormatT::Shift[Channel] + FormatT::Bits[Channel] < 16 )
+		{
+			ChannelWords = _mm256_and_si256(
+				ChannelWords,
+				_mm256_set1_epi16(ChannelMask<FormatT, Channel>)
+			);
+		}
+		ChannelSum64 = _mm256_add_epi64(
+			ChannelSum64,
+			_mm256_sad_epu8(ChannelWords, _mm256_setzero_si256())
+		);
+	}
+}
+
+// 32-bit formats: channels are wider than a byte, so they are summed into
+// 32-bit lanes instead. In the worst case where every channel is saturated
+// the 32-bit accumulator would overflow after-
+// ( 0xFFFFFFFF / 0x3FF ) = >>> 0x400401 iterations <<<
+//        ^         ^ a saturated 10-bit channel
+//        | a saturated register is made out of...
+#define SPANADD10 ( 0xFFFFFFFF / 0x3FF )
+#if defined(__AVX512BW__)
+template< typename FormatT, std::size_t Channel >
+inline void SumChannel32( __m512i& ChannelSum32, __m512i Pixels )
+{
+	if constexpr( FormatT::Bits[Channel] == 0 ) return;
+	else
+	{
+		__m512i ChannelDwords = qColorKernel::ShiftRight32<FormatT::Shift[Channel]>(Pixels);
+		if constexpr( FormatT::Shift[Channel] + FormatT::Bits[Channel] < 32 )
+		{
+			ChannelDwords = _mm512_and_si512(
+				ChannelDwords,
+				_mm512_set1_epi32(ChannelMask<FormatT, Channel>)
+			);
+		}
+		ChannelSum32 = _mm512_add_epi32(ChannelSum32, ChannelDwords);
+	}
+}
+#endif
+
+template< typename FormatT, std::size_t Channel >
+inline void SumChannel32( __m256i& ChannelSum32, __m256i Pixels )
+{
+	if constexpr( FormatT::Bits[Channel] == 0 ) return;
+	else
+	{
+		__m256i ChannelDwords = _mm256_srli_epi32(Pixels, FormatT::Shift[Channel]);
+		if constexpr( FormatT::Shift[Channel] + FormatT::Bits[Channel] < 32 )
+		{
+			ChannelDwords = _mm256_and_si256(
+				ChannelDwords,
+				_mm256_set1_epi32(ChannelMask<FormatT, Channel>)
+			);
+		}
+		ChannelSum32 = _mm256_add_epi32(ChannelSum32, ChannelDwords);
+	}
+}
+
+inline std::uint64_t HorizontalSum64( __m256i Sum64 )
+{
+	const __m128i Sum64x2 = _mm_add_epi64(
+		_mm256_castsi256_si128(Sum64), _mm256_extracti128_si256(Sum64, 1)
+	);
+	return _mm_cvtsi128_si64(Sum64x2) + _mm_extract_epi64(Sum64x2, 1);
+}
+
+inline __m256i WidenSum32( __m256i Sum32 )
+{
+	return _mm256_add_epi64(
+		_mm256_cvtepu32_epi64(_mm256_castsi256_si128(Sum32)),
+		_mm256_cvtepu32_epi64(_mm256_extracti128_si256(Sum32, 1))
+	);
+}
+
+template< typename FormatT >
+qColorSum SumPacked(
+	const typename FormatT::PixelT Pixels[],
+	std::size_t Count
+)
+{
+	// Pixels per 256-bit register
+	constexpr std::size_t Lanes = 32 / sizeof(typename FormatT::PixelT);
+	std::size_t i = 0;
+
+	// | RSum64 | GSum64 | BSum64 | ASum64 | Each horizontally summed at the end
+	__m256i ChannelSum64[4] = {
+		_mm256_setzero_si256(), _mm256_setzero_si256(),
+		_mm256_setzero_si256(), _mm256_setzero_si256()
+	};
+
+	if constexpr( sizeof(typename FormatT::PixelT) == 2 )
+	{
+#if defined(__AVX512BW__)
+		// 32 pixels at a time! (AVX512)
+		__m512i ChannelSum64x2[4] = {
+			_mm512_setzero_si512(), _mm512_setzero_si512(),
+			_mm512_setzero_si512(), _mm512_setzero_si512()
+		};
+		for( std::size_t j = i/32; j < Count/32; j++, i += 32 )
+		{
+			const __m512i Pixels32 = _mm512_loadu_si512((const __m512i*)&Pixels[i]);
+			SumChannel16<FormatT, 0>(ChannelSum64x2[0], Pixels32);
+			SumChannel16<FormatT, 1>(ChannelSum64x2[1], Pixels32);
+			SumChannel16<FormatT, 2>(ChannelSum64x2[2], Pixels32);
+			SumChannel16<FormatT, 3>(ChannelSum64x2[3], Pixels32);
+		}
+		for( std::size_t Channel = 0; Channel < 4; ++Channel )
+		{
+			ChannelSum64[Channel] = qColorKernel::FoldSum64(ChannelSum64x2[Channel]);
+		}
+#endif
+		// 16 pixels at a time! (AVX2)
+		for( std::size_t j = i/Lanes; j < Count/Lanes; j++, i += Lanes )
+		{
+			const __m256i Pixels16 = _mm256_loadu_si256((const __m256i*)&Pixels[i]);
+			SumChannel16<FormatT, 0>(ChannelSum64[0], Pixels16);
+			SumChannel16<FormatT, 1>(ChannelSum64[1], Pixels16);
+			SumChannel16<FormatT, 2>(ChannelSum64[2], Pixels16);
+			SumChannel16<FormatT, 3>(ChannelSum64[3], Pixels16);
+		}
+	}
+	else
+	{
+#if defined(__AVX512BW__)
+		// 16 pixels at a time! (AVX512)
+		for( std::size_t j = i/16; j < Count/16; )
+		{
+			// 32-bit accumulators
+			__m512i ChannelSum32[4] = {
+				_mm512_setzero_si512(), _mm512_setzero_si512(),
+				_mm512_setzero_si512(), _mm512_setzero_si512()
+			};
+			for(
+				std::size_t k = 0;
+				(k < SPANADD10) && (j < Count/16);
+				k++, j++, i += 16
+			)
+			{
+				const __m512i Pixels16 = _mm512_loadu_si512((const __m512i*)&Pixels[i]);
+				SumChannel32<FormatT, 0>(ChannelSum32[0], Pixels16);
+				SumChannel32<FormatT, 1>(ChannelSum32[1], Pixels16);
+				SumChannel32<FormatT, 2>(ChannelSum32[2], Pixels16);
+				SumChannel32<FormatT, 3>(ChannelSum32[3], Pixels16);
+			}
+			for( std::size_t Channel = 0; Channel < 4; ++Channel )
+			{
+				ChannelSum64[Channel] = _mm256_add_epi64(
+					ChannelSum64[Channel],
+					WidenSum32(qColorKernel::Lower256(ChannelSum32[Channel]))
+				);
+				ChannelSum64[Channel] = _mm256_add_epi64(
+					ChannelSum64[Channel],
+					WidenSum32(qColorKernel::Upper256(ChannelSum32[Channel]))
+				);
+			}
+		}
+#endif
+		// 8 pixels at a time! (AVX2)
+		for( std::size_t j = i/Lanes; j < Count/Lanes; )
+		{
+			// 32-bit accumulators
+			__m256i ChannelSum32[4] = {
+				_mm256_setzero_si256(), _mm256_setzero_si256(),
+				_mm256_setzero_si256(), _mm256_setzero_si256()
+			};
+			for(
+				std::size_t k = 0;
+				(k < SPANADD10) && (j < Count/Lanes);
+				k++, j++, i += Lanes
+			)
+			{
+				const __m256i Pixels8 = _mm256_loadu_si256((const __m256i*)&Pixels[i]);
+				SumChannel32<FormatT, 0>(ChannelSum32[0], Pixels8);
+				SumChannel32<FormatT, 1>(ChannelSum32[1], Pixels8);
+				SumChannel32<FormatT, 2>(ChannelSum32[2], Pixels8);
+				SumChannel32<FormatT, 3>(ChannelSum32[3], Pixels8);
+			}
+			for( std::size_t Channel = 0; Channel < 4; ++Channel )
+			{
+				ChannelSum64[Channel] = _mm256_add_epi64(
+					ChannelSum64[Channel], WidenSum32(ChannelSum32[Channel])
+				);
+			}
+		}
+	}
+
+	// Horizontal sum into just one 64-bit sum now
+	qColorSum Sum;
+	Sum.Red   = HorizontalSum64(ChannelSum64[0]);
+	Sum.Green = HorizontalSum64(ChannelSum64[1]);
+	Sum.Blue  = HorizontalSum64(ChannelSum64[2]);
+	Sum.Alpha = HorizontalSum64(ChannelSum64[3]);
+
+	// Serial
+	for( ; i < Count; ++i )
+	{
+		const std::uint32_t CurColor = Pixels[i];
+		Sum.Red   += (CurColor >> FormatT::Shift[0]) & ChannelMask<FormatT, 0>;
+		Sum.Green += (CurColor >> FormatT::Shift[1]) & ChannelMask<FormatT, 1>;
+		Sum.Blue  += (CurColor >> FormatT::Shift[2]) & ChannelMask<FormatT, 2>;
+		Sum.Alpha += (CurColor >> FormatT::Shift[3]) & ChannelMask<FormatT, 3>;
+	}
+
+	Sum.Count = Count;
+	return Sum;
+}
+
+#undef SPANADD10
+
+// Average, then interleave back into the native format
+template< typename FormatT >
+typename FormatT::PixelT PackAverage( const qColorSum& Sum )
+{
+	if( Sum.Count == 0 ) return 0;
+	return static_cast<typename FormatT::PixelT>(
+		((Sum.Red   / Sum.Count) << FormatT::Shift[0]) |
+		((Sum.Green / Sum.Count) << FormatT::Shift[1]) |
+		((Sum.Blue  / Sum.Count) << FormatT::Shift[2]) |
+		((Sum.Alpha / Sum.Count) << FormatT::Shift[3])
+	);
+}
+
+// Average, rescaled from the native channel depth to 8 bits with rounding
+// An absent alpha channel is opaque
+template< typename FormatT, std::size_t Channel >
+std::uint32_t AverageToUNORM8( std::uint64_t ChannelSum, std::uint64_t Count )
+{
+	if constexpr( FormatT::Bits[Channel] == 0 ) return 0xFF;
+	else
+	{
+		const std::uint64_t Range = Count * ChannelMask<FormatT, Channel>;
+		return static_cast<std::uint32_t>( (ChannelSum * 0xFF + Range / 2) / Range );
+	}
+}
+
+template< typename FormatT >
+std::uint32_t PackAverageRGBA8( const qColorSum& Sum )
+{
+	if( Sum.Count == 0 ) return 0;
+	return
+		(AverageToUNORM8<FormatT, 3>(Sum.Alpha, Sum.Count) << 24) |
+		(AverageToUNORM8<FormatT, 2>(Sum.Blue,  Sum.Count) << 16) |
+		(AverageToUNORM8<FormatT, 1>(Sum.Green, Sum.Count) <<  8) |
+		(AverageToUNORM8<FormatT, 0>(Sum.Red,   Sum.Count) <<  0);
+}
+
+}
+
+qColorSum qSumColorRGB565(const std::uint16_t Pixels[], std::size_t Count)
+{
+	return SumPacked<FormatRGB565>(Pixels, Count);
+}
+
+std::uint16_t qAverageColorRGB565(const std::uint16_t Pixels[], std::size_t Count)
+{
+	return PackAverage<FormatRGB565>(qSumColorRGB565(Pixels, Count));
+}
+
+std::uint32_t qAverageColorRGB565ToRGBA8(const std::uint16_t Pixels[], std::size_t Count)
+{
+	return PackAverageRGBA8<FormatRGB565>(qSumColorRGB565(Pixels, Count));
+}
+
+qColorSum qSumColorRGBA4444(const std::uint16_t Pixels[], std::size_t Count)
+{
+	return SumPacked<FormatRGBA4444>(Pixels, Count);
+}
+
+std::uint16_t qAverageColorRGBA4444(const std::uint16_t Pixels[], std::size_t Count)
+{
+	return PackAverage<FormatRGBA4444>(qSumColorRGBA4444(Pixels, Count));
+}
+
+std::uint32_t qAverageColorRGBA4444ToRGBA8(const std::uint16_t Pixels[], std::size_t Count)
+{
+	return PackAverageRGBA8<FormatRGBA4444>(qSumColorRGBA4444(Pixels, Count));
+}
+
+qColorSum qSumColorRGB10A2(const std::uint32_t Pixels[], std::size_t Count)
+{
+	return SumPacked<FormatRGB10A2>(Pixels, Count);
+}
+
+std::uint32_t qAverageColorRGB10A2(const std::uint32_t Pixels[], std::size_t Count)
+{
+	return PackAverage<FormatRGB10A2>(qSumColorRGB10A2(Pixels, Count));
+}
+
+std::uint32_t qAverageColorRGB10A2ToRGBA8(const std::uint32_t Pixels[], std::size_t Count)
+{
+	return PackAverageRGBA8<FormatRGB10A2>(qSumColorRGB10A2(Pixels, Count));
+}
@@ -0,0 +1,433 @@
+#include <qAverageColor.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+// Pixels are handed out to threads in chunks of 1MiB, enough to amortize the
+// scheduling and large enough to span whole pages of any size but 1GiB
+constexpr std::size_t ChunkPixels = 256 * 1024;
+
+std::size_t ChunkCount( std::size_t Count )
+{
+	return (Count + ChunkPixels - 1) / ChunkPixels;
+}
+
+qColorSum SumChunk(
+	const std::uint32_t Pixels[], std::size_t Count, std::size_t Chunk
+)
+{
+	const std::size_t Begin = Chunk * ChunkPixels;
+	return qColorKernel::Sum<qColorKernel::OrderFormat<qChannelOrder::RGBA>>(
+		&Pixels[Begin], std::min(ChunkPixels, Count - Begin)
+	);
+}
+
+std::size_t DefaultThreadCount()
+{
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// A unit of work-stealing batch work, either a chunk of one large image or a
+// run of consecutive small images that are packed together
+struct BatchTask
+{
+	std::size_t Image;
+	// Whole images [Image, Image + ImageCount), or the ChunkCount pixels
+	// starting at Offset of Image when ImageCount is 0
+	std::size_t ImageCount;
+	std::size_t Offset, ChunkCount;
+};
+
+// One worker's share of the batch: the tasks [Front, Back) of the task list.
+// Tasks never spawn new tasks, so a share only ever shrinks. The owner takes
+// from the front, thieves take from the back, so the owner works through its
+// share in memory order while thieves take the work that it would have
+// gotten to last. Both ends are packed into one atomic word, so every take is
+// a single compare-and-swap and the last task goes to exactly one taker,
+// without any lock. Shares sit on cache lines of their own
+class alignas(64) TaskShare
+{
+public:
+	void Assign( std::size_t Front, std::size_t Back )
+	{
+		Ends.store(Pack(Front, Back), std::memory_order_relaxed);
+	}
+	bool Pop( std::size_t& Task )
+	{
+		std::uint64_t Current = Ends.load(std::memory_order_relaxed);
+		for( ;; )
+		{
+			const std::uint64_t Front = Current >> 32, Back = Current & 0xFFFFFFFF;
+			if( Front == Back ) return false;
+			if(
+				Ends.compare_exchange_weak(
+					Current, Pack(Front + 1, Back), std::memory_order_relaxed
+				)
+			)
+			{
+				Task = Front;
+				return true;
+			}
+		}
+	}
+	bool Steal( std::size_t& Task )
+	{
+		std::uint64_t Current = Ends.load(std::memory_order_relaxed);
+		for( ;; )
+		{
+			const std::uint64_t Front = Current >> 32, Back = Current & 0xFFFFFFFF;
+			if( Front == Back ) return false;
+			if(
+				Ends.compare_exchange_weak(
+					Current, Pack(Front, Back - 1), std::memory_order_relaxed
+				)
+			)
+			{
+				Task = Back - 1;
+				return true;
+			}
+		}
+	}
+
+private:
+	static std::uint64_t Pack( std::uint64_t Front, std::uint64_t Back )
+	{
+		return (Front << 32) | Back;
+	}
+	// | Front | Back |
+	std::atomic<std::uint64_t> Ends{0};
+};
+
+#if defined(__linux__)
+// Parses the "0-3,8,10-11" lists of sysfs
+std::vector<int> ReadList( const char* Path )
+{
+	std::vector<int> List;
+	std::FILE* File = std::fopen(Path, "r");
+	if( File == nullptr ) return List;
+	int First;
+	while( std::fscanf(File, "%d", &First) == 1 )
+	{
+		int Last = First;
+		int Separator = std::fgetc(File);
+		if( Separator == '-' )
+		{
+			if( std::fscanf(File, "%d", &Last) != 1 ) break;
+			Separator = std::fgetc(File);
+		}
+		for( int i = First; i <= Last; ++i ) List.push_back(i);
+		if( Separator != ',' ) break;
+	}
+	std::fclose(File);
+	return List;
+}
+
+struct NUMANode
+{
+	int Node;
+	std::vector<int> CPUs;
+};
+
+// Every node that has CPUs on it, read once. Memory-only nodes can not run a
+// thread of their own, their chunks are left to the other nodes
+const std::vector<NUMANode>& Topology()
+{
+	static const std::vector<NUMANode> Nodes = []()
+	{
+		std::vector<NUMANode> Nodes;
+		std::vector<int> Online = ReadList("/sys/devices/system/node/has_cpu");
+		if( Online.empty() ) Online = ReadList("/sys/devices/system/node/online");
+		for( const int Node : Online )
+		{
+			char Path[64];
+			std::snprintf(
+				Path, sizeof(Path), "/sys/devices/system/node/node%d/cpulist", Node
+			);
+			std::vector<int> CPUs = ReadList(Path);
+			if( !CPUs.empty() ) Nodes.push_back({Node, std::move(CPUs)});
+		}
+		return Nodes;
+	}();
+	return Nodes;
+}
+
+// Chunks of pixels whose memory is on a node
+struct NodeChunks
+{
+	std::vector<std::size_t> Chunks;
+	std::atomic<std::size_t> Next{0};
+};
+#endif
+
+}
+
+qColorSum qSumColorRGBA8Parallel(
+	const std::uint32_t Pixels[],
+	std::size_t Count,
+	std::size_t ThreadCount
+)
+{
+	const std::size_t Chunks = ChunkCount(Count);
+	ThreadCount = std::min(
+		ThreadCount ? ThreadCount : DefaultThreadCount(), std::max<std::size_t>(Chunks, 1)
+	);
+
+	std::atomic<std::size_t> NextChunk(0);
+	std::mutex SumMutex;
+	qColorSum Sum = {};
+	const auto Worker = [&]()
+	{
+		qColorSum ThreadSum = {};
+		for(
+			std::size_t Chunk = NextChunk++; Chunk < Chunks; Chunk = NextChunk++
+		)
+		{
+			ThreadSum += SumChunk(Pixels, Count, Chunk);
+		}
+		std::lock_guard<std::mutex> Lock(SumMutex);
+		Sum += ThreadSum;
+	};
+
+	std::vector<std::thread> Threads;
+	for( std::size_t i = 1; i < ThreadCount; ++i ) Threads.emplace_back(Worker);
+	Worker();
+	for( std::thread& Thread : Threads ) Thread.join();
+	return Sum;
+}
+
+std::uint32_t qAverageColorRGBA8Parallel(
+	const std::uint32_t Pixels[],
+	std::size_t Count,
+	std::size_t ThreadCount
+)
+{
+	return qColorKernel::PackAverageRGBA8(
+		qSumColorRGBA8Parallel(Pixels, Count, ThreadCount)
+	);
+}
+
+qColorSum qSumColorRGBA8NUMA(
+	const std::uint32_t Pixels[],
+	std::size_t Count
+)
+{
+#if defined(__linux__) && defined(SYS_move_pages)
+	// With a single node there is no remote memory to avoid, and querying
+	// and pinning would only cost time over the plain parallel path
+	const std::vector<NUMANode>& Nodes = Topology();
+	const std::size_t Chunks = ChunkCount(Count);
+	if( Nodes.size() < 2 || Chunks < 2 )
+	{
+		return qSumColorRGBA8Parallel(Pixels, Count, 0);
+	}
+
+	// move_pages without any target nodes just reports the node that each
+	// page is currently on. Chunks span whole pages, so the first page of a
+	// chunk stands in for all of it
+	const std::uintptr_t PageSize = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+	std::vector<void*> Pages(Chunks);
+	std::vector<int> Status(Chunks, -1);
+	for( std::size_t Chunk = 0; Chunk < Chunks; ++Chunk )
+	{
+		Pages[Chunk] = reinterpret_cast<void*>(
+			reinterpret_cast<std::uintptr_t>(&Pixels[Chunk * ChunkPixels])
+			& ~(PageSize - 1)
+		);
+	}
+	if(
+		syscall(
+			SYS_move_pages, 0, Chunks, Pages.data(), nullptr, Status.data(), 0
+		) != 0
+	)
+	{
+		return qSumColorRGBA8Parallel(Pixels, Count, 0);
+	}
+	std::vector<NodeChunks> Owned(Nodes.size());
+	for( std::size_t Chunk = 0; Chunk < Chunks; ++Chunk )
+	{
+		// Pages that are not resident(negative status) or that are on a
+		// memory-only node go to any node
+		std::size_t Owner = Chunk % Nodes.size();
+		for( std::size_t i = 0; i < Nodes.size(); ++i )
+		{
+			if( Nodes[i].Node == Status[Chunk] ) Owner = i;
+		}
+		Owned[Owner].Chunks.push_back(Chunk);
+	}
+
+	std::mutex SumMutex;
+	qColorSum Sum = {};
+	// Threads drain the chunks of their own node first, and then help out
+	// with the remaining chunks of the other nodes
+	const auto Worker = [&]( std::size_t Home )
+	{
+		// Any CPU of the node will do, the scheduler balances within it
+		cpu_set_t NodeSet;
+		CPU_ZERO(&NodeSet);
+		for( const int CPU : Nodes[Home].CPUs ) CPU_SET(CPU, &NodeSet);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &NodeSet);
+
+		qColorSum ThreadSum = {};
+		for( std::size_t Offset = 0; Offset < Nodes.size(); ++Offset )
+		{
+			NodeChunks& Node = Owned[(Home + Offset) % Nodes.size()];
+			for(
+				std::size_t Index = Node.Next++;
+				Index < Node.Chunks.size();
+				Index = Node.Next++
+			)
+			{
+				ThreadSum += SumChunk(Pixels, Count, Node.Chunks[Index]);
+			}
+		}
+		std::lock_guard<std::mutex> Lock(SumMutex);
+		Sum += ThreadSum;
+	};
+
+	std::vector<std::thread> Threads;
+	for( std::size_t Home = 0; Home < Nodes.size(); ++Home )
+	{
+		for( std::size_t i = 0; i < Nodes[Home].CPUs.size(); ++i )
+		{
+			Threads.emplace_back(Worker, Home);
+		}
+	}
+	for( std::thread& Thread : Threads ) Thread.join();
+	return Sum;
+#else
+	return qSumColorRGBA8Parallel(Pixels, Count, 0);
+#endif
+}
+
+std::uint32_t qAverageColorRGBA8NUMA(
+	const std::uint32_t Pixels[],
+	std::size_t Count
+)
+{
+	return qColorKernel::PackAverageRGBA8(qSumColorRGBA8NUMA(Pixels, Count));
+}
+
+void qSumColorRGBA8BatchParallel(
+	const std::uint32_t* const Images[],
+	const std::size_t Counts[],
+	std::size_t ImageCount,
+	qColorSum Sums[],
+	std::size_t ThreadCount
+)
+{
+	// Images larger than a chunk are split into chunks, and runs of smaller
+	// images are packed into tasks of up to a chunk's worth of pixels
+	std::vector<BatchTask> Tasks;
+	for( std::size_t Image = 0; Image < ImageCount; )
+	{
+		if( Counts[Image] > ChunkPixels )
+		{
+			for( std::size_t Offset = 0; Offset < Counts[Image]; Offset += ChunkPixels )
+			{
+				Tasks.push_back(
+					{Image, 0, Offset, std::min(ChunkPixels, Counts[Image] - Offset)}
+				);
+			}
+			++Image;
+			continue;
+		}
+		BatchTask Pack = {Image, 0, 0, 0};
+		std::size_t PackPixels = 0;
+		while(
+			Image < ImageCount && Counts[Image] <= ChunkPixels
+			&& (Pack.ImageCount == 0 || PackPixels + Counts[Image] <= ChunkPixels)
+		)
+		{
+			PackPixels += Counts[Image++];
+			++Pack.ImageCount;
+		}
+		Tasks.push_back(Pack);
+	}
+
+	ThreadCount = std::min(
+		ThreadCount ? ThreadCount : DefaultThreadCount(),
+		std::max<std::size_t>(Tasks.size(), 1)
+	);
+	// Every worker starts out with a contiguous share of the tasks. Task
+	// indices are kept to 32 bits, a task is at least one whole image or chunk
+	std::vector<TaskShare> Shares(ThreadCount);
+	for( std::size_t i = 0; i < ThreadCount; ++i )
+	{
+		Shares[i].Assign(
+			i * Tasks.size() / ThreadCount, (i + 1) * Tasks.size() / ThreadCount
+		);
+	}
+
+	// Chunks of the same image may be summed by different threads. Their
+	// partial sums are merged once all the threads are done
+	for( std::size_t Image = 0; Image < ImageCount; ++Image )
+	{
+		Sums[Image] = qColorSum{};
+	}
+	std::vector<std::vector<std::pair<std::size_t, qColorSum>>> ChunkSums(
+		ThreadCount
+	);
+
+	const auto Worker = [&]( std::size_t Self )
+	{
+		std::size_t Index;
+		for( ;; )
+		{
+			bool Found = Shares[Self].Pop(Index);
+			for( std::size_t Victim = 1; !Found && Victim < ThreadCount; ++Victim )
+			{
+				Found = Shares[(Self + Victim) % ThreadCount].Steal(Index);
+			}
+			// Tasks never spawn new tasks, so once every share is empty
+			// there is nothing left to wait for
+			if( !Found ) break;
+
+			const BatchTask& Task = Tasks[Index];
+
+			if( Task.ImageCount == 0 )
+			{
+				ChunkSums[Self].emplace_back(
+					Task.Image,
+					qColorKernel::Sum<qColorKernel::OrderFormat<qChannelOrder::RGBA>>(
+						&Images[Task.Image][Task.Offset], Task.ChunkCount
+					)
+				);
+				continue;
+			}
+			for( std::size_t Image = Task.Image; Image < Task.Image + Task.ImageCount; ++Image )
+			{
+				Sums[Image] = qColorKernel::Sum<
+					qColorKernel::OrderFormat<qChannelOrder::RGBA>
+				>(Images[Image], Counts[Image]);
+			}
+		}
+	};
+
+	std::vector<std::thread> Threads;
+	for( std::size_t i = 1; i < ThreadCount; ++i ) Threads.emplace_back(Worker, i);
+	Worker(0);
+	for( std::thread& Thread : Threads ) Thread.join();
+
+	for( const auto& ThreadChunkSums : ChunkSums )
+	{
+		for( const auto& ChunkSum : ThreadChunkSums )
+		{
+			Sums[ChunkSum.first] += ChunkSum.second;
+		}
+	}
+}
@@ -0,0 +1,221 @@
+#include <qAverageColor.hpp>
+
+#include <immintrin.h>
+
+std::uint64_t AverageColorRGBA16(
+	const std::uint64_t Pixels[],
+	std::size_t Count
+)
+{
+	std::uint64_t RedSum, GreenSum, BlueSum, AlphaSum;
+	RedSum = GreenSum = BlueSum = AlphaSum = 0;
+	for( std::size_t i = 0; i < Count; ++i )
+	{
+		const std::uint64_t& CurColor = Pixels[i];
+		AlphaSum += static_cast<std::uint16_t>( CurColor >> 48 );
+		BlueSum  += static_cast<std::uint16_t>( CurColor >> 32 );
+		GreenSum += static_cast<std::uint16_t>( CurColor >> 16 );
+		RedSum   += static_cast<std::uint16_t>( CurColor >>  0 );
+	}
+	RedSum   /= Count;
+	GreenSum /= Count;
+	BlueSum  /= Count;
+	AlphaSum /= Count;
+
+	return
+		(static_cast<std::uint64_t>( (std::uint16_t)AlphaSum ) << 48 ) |
+		(static_cast<std::uint64_t>( (std::uint16_t) BlueSum ) << 32 ) |
+		(static_cast<std::uint64_t>( (std::uint16_t)GreenSum ) << 16 ) |
+		(static_cast<std::uint64_t>( (std::uint16_t)  RedSum ) <<  0 );
+}
+
+// vpmaddwd/vpdpwssd only multiply signed 16-bit integers. Each channel gets
+// biased into the signed range first by flipping its top bit:
+//   Channel ^ 0x8000 = Channel - 0x8000
+// and the bias is added back once per pixel at the very end.
+// In the worst case, where every biased channel is -0x8000:
+// We are horizontally summing 2 channel-words at a time into a 32-bit
+// accumulator. The signed 32-bit accumulator would overflow after-
+// ( (0x7FFFFFFF / ( 0x8000 * 2 ) ) = >>> 0x7FFF iterations <<<
+//       ^             ^      ^ Number of words summed into accumulator
+//       |             |        at each iteration
+//       |             | the largest biased channel magnitude
+//       | a saturated signed register is made out of...
+#define SPANMADD2 (0x7FFFFFFF / ( 0x8000 * 2 ) )
+
+qColorSum qSumColorRGBA16(
+	const std::uint64_t Pixels[],
+	std::size_t Count
+)
+{
+	std::size_t i = 0;
+
+#if defined(__AVX512BW__)
+	// 8 pixels at a time! (AVX512)
+	// | ASum64 | BSum64 | GSum64 | RSum64 | ASum64 | BSum64 | GSum64 | RSum64 |
+	__m512i RGBASum64x2 = _mm512_setzero_si512();
+	for( std::size_t j = i/8; j < Count/8; )
+	{
+		// Signed 32-bit accumulators
+		__m512i RGBASum32x4 = _mm512_setzero_si512();
+		for(
+			std::size_t k = 0;
+			(k < SPANMADD2) && (j < Count/8);
+			k++, j++, i += 8
+		)
+		{
+			const __m512i OctaPixel = _mm512_xor_si512(
+				_mm512_loadu_si512((__m512i*)&Pixels[i]),
+				_mm512_set1_epi16(std::int16_t(0x8000))
+			);
+			// Shuffle within 128-bit lanes so that the same channel of the
+			// two pixels within each lane are adjacent words
+			// | AABBGGRR | AABBGGRR | ... x4
+			// | AAAABBBB | GGGGRRRR | ... x4
+			const __m512i Deinterleave = _mm512_shuffle_epi8(
+				OctaPixel,
+				_mm512_set4_epi32(
+					// Alpha
+					0x0F0E0706,
+					// Blue
+					0x0D0C0504,
+					// Green
+					0x0B0A0302,
+					// Red
+					0x09080100
+				)
+			);
+			// | AA | AA | BB | BB | GG | GG | RR | RR | ... x2
+			// | ** | ** | ** | ** | ** | ** | ** | ** |
+			// | 11 | 11 | 11 | 11 | 11 | 11 | 11 | 11 | ... x2
+			// |hadd|hadd|hadd|hadd|hadd|hadd|hadd|hadd|
+			// |ASum32|BSum32|GSum32|RSum32|ASum32|BSum32|GSum32|RSum32| x2
+#if defined(__AVX512VNNI__)
+			RGBASum32x4 = _mm512_dpwssd_epi32(
+				RGBASum32x4, Deinterleave, _mm512_set1_epi16(1)
+			);
+#else
+			RGBASum32x4 = _mm512_add_epi32(
+				RGBASum32x4,
+				_mm512_madd_epi16(Deinterleave, _mm512_set1_epi16(1))
+			);
+#endif
+		}
+		// Lower Sum32s
+		RGBASum64x2 = _mm512_add_epi64(
+			RGBASum64x2,
+			qColorKernel::WidenSigned32(qColorKernel::Lower256(RGBASum32x4))
+		);
+		// Upper Sum32s
+		RGBASum64x2 = _mm512_add_epi64(
+			RGBASum64x2,
+			qColorKernel::WidenSigned32(qColorKernel::Upper256(RGBASum32x4))
+		);
+	}
+
+	// | ASum64 | BSum64 | GSum64 | RSum64 |
+	__m256i RGBASum64 = qColorKernel::FoldSum64(RGBASum64x2);
+#else
+	__m256i RGBASum64 = _mm256_setzero_si256();
+#endif
+	// 4 pixels at a time! (AVX2)
+	for( std::size_t j = i/4; j < Count/4; )
+	{
+		// Signed 32-bit accumulators
+		__m256i RGBASum32x2 = _mm256_setzero_si256();
+		for(
+			std::size_t k = 0;
+			(k < SPANMADD2) && (j < Count/4);
+			k++, j++, i += 4
+		)
+		{
+			const __m256i QuadPixel = _mm256_xor_si256(
+				_mm256_loadu_si256((__m256i*)&Pixels[i]),
+				_mm256_set1_epi16(std::int16_t(0x8000))
+			);
+			// | AABBGGRR | AABBGGRR | x2
+			// | AAAABBBB | GGGGRRRR | x2
+			const __m256i Deinterleave = _mm256_shuffle_epi8(
+				QuadPixel,
+				_mm256_broadcastsi128_si256(
+					_mm_set_epi8(
+						// Alpha
+						15,14, 7, 6,
+						// Blue
+						13,12, 5, 4,
+						// Green
+						11,10, 3, 2,
+						// Red
+						 9, 8, 1, 0
+					)
+				)
+			);
+			// |ASum32|BSum32|GSum32|RSum32|ASum32|BSum32|GSum32|RSum32|
+			RGBASum32x2 = _mm256_add_epi32(
+				RGBASum32x2,
+				_mm256_madd_epi16(Deinterleave, _mm256_set1_epi16(1))
+			);
+		}
+		// | ASum64 | BSum64 | GSum64 | RSum64 |
+		RGBASum64 = _mm256_add_epi64(
+			RGBASum64,
+			_mm256_cvtepi32_epi64(_mm256_castsi256_si128(RGBASum32x2))
+		);
+		RGBASum64 = _mm256_add_epi64(
+			RGBASum64,
+			_mm256_cvtepi32_epi64(_mm256_extracti128_si256(RGBASum32x2, 1))
+		);
+	}
+
+	// Remove the bias from the pixels that went through the SIMD loops
+	RGBASum64 = _mm256_add_epi64(
+		RGBASum64,
+		_mm256_set1_epi64x(static_cast<std::int64_t>(i) * 0x8000)
+	);
+
+	// Horizontal sum into just one 64-bit sum now
+	const __m128i RedGreenSum64  = _mm256_castsi256_si128(RGBASum64);
+	const __m128i BlueAlphaSum64 = _mm256_extracti128_si256(RGBASum64, 1);
+	qColorSum Sum;
+	Sum.Red   = _mm_cvtsi128_si64(RedGreenSum64);
+	Sum.Green = _mm_extract_epi64(RedGreenSum64, 1);
+	Sum.Blue  = _mm_cvtsi128_si64(BlueAlphaSum64);
+	Sum.Alpha = _mm_extract_epi64(BlueAlphaSum64, 1);
+
+	// Serial
+	for( ; i < Count; ++i )
+	{
+		const std::uint64_t CurColor = Pixels[i];
+		Sum.Alpha += static_cast<std::uint16_t>( CurColor >> 48 );
+		Sum.Blue  += static_cast<std::uint16_t>( CurColor >> 32 );
+		Sum.Green += static_cast<std::uint16_t>( CurColor >> 16 );
+		Sum.Red   += static_cast<std::uint16_t>( CurColor       );
+	}
+
+	Sum.Count = Count;
+	return Sum;
+}
+
+#undef SPANMADD2
+
+std::uint64_t qAverageColorRGBA16(
+	const std::uint64_t Pixels[],
+	std::size_t Count
+)
+{
+	const qColorSum Sum = qSumColorRGBA16(Pixels, Count);
+	if( Sum.Count == 0 ) return 0;
+
+	// Average
+	const std::uint64_t RedAverage   = Sum.Red   / Sum.Count;
+	const std::uint64_t GreenAverage = Sum.Green / Sum.Count;
+	const std::uint64_t BlueAverage  = Sum.Blue  / Sum.Count;
+	const std::uint64_t AlphaAverage = Sum.Alpha / Sum.Count;
+
+	// Interleave
+	return
+		(static_cast<std::uint64_t>( (std::uint16_t)AlphaAverage ) << 48 ) |
+		(static_cast<std::uint64_t>( (std::uint16_t) BlueAverage ) << 32 ) |
+		(static_cast<std::uint64_t>( (std::uint16_t)GreenAverage ) << 16 ) |
+		(static_cast<std::uint64_t>( (std::uint16_t)  RedAverage ) <<  0 );
+}
@@ -0,0 +1,340 @@
+#include <qAverageColor.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#include <immintrin.h>
+
+namespace
+{
+
+// Sum of Count bytes
+// | ******** | ******** | ******** | ******** |
+// |  Sum64   |  Sum64   |  Sum64   |  Sum64   |
+std::uint64_t SumBytes( const std::uint8_t Bytes[], std::size_t Count )
+{
+	std::size_t i = 0;
+#if defined(__AVX512BW__)
+	__m512i Sum64x8 = _mm512_setzero_si512();
+	for( std::size_t j = i/64; j < Count/64; j++, i += 64 )
+	{
+		Sum64x8 = _mm512_add_epi64(
+			Sum64x8,
+			_mm512_sad_epu8(
+				_mm512_loadu_si512((const __m512i*)&Bytes[i]),
+				_mm512_setzero_si512()
+			)
+		);
+	}
+	__m256i Sum64x4 = qColorKernel::FoldSum64(Sum64x8);
+#else
+	__m256i Sum64x4 = _mm256_setzero_si256();
+#endif
+	for( std::size_t j = i/32; j < Count/32; j++, i += 32 )
+	{
+		Sum64x4 = _mm256_add_epi64(
+			Sum64x4,
+			_mm256_sad_epu8(
+				_mm256_loadu_si256((const __m256i*)&Bytes[i]),
+				_mm256_setzero_si256()
+			)
+		);
+	}
+	const __m128i Sum64x2 = _mm_add_epi64(
+		_mm256_castsi256_si128(Sum64x4), _mm256_extracti128_si256(Sum64x4, 1)
+	);
+	std::uint64_t Sum = _mm_cvtsi128_si64(Sum64x2) + _mm_extract_epi64(Sum64x2, 1);
+	for( ; i < Count; ++i )
+	{
+		Sum += Bytes[i];
+	}
+	return Sum;
+}
+
+// Sums of the even and odd bytes of Count byte-pairs(NV12's interleaved UV)
+// | VUVUVUVU | VUVUVUVU |
+// | 0U0U0U0U | 0U0U0U0U | & 0x00FF
+// | 0V0V0V0V | 0V0V0V0V | >> 8
+void SumBytePairs(
+	const std::uint8_t Pairs[], std::size_t Count,
+	std::uint64_t& EvenSum, std::uint64_t& OddSum
+)
+{
+	std::size_t i = 0;
+#if defined(__AVX512BW__)
+	__m512i EvenSum64x8 = _mm512_setzero_si512();
+	__m512i OddSum64x8  = _mm512_setzero_si512();
+	for( std::size_t j = i/32; j < Count/32; j++, i += 32 )
+	{
+		const __m512i Bytes = _mm512_loadu_si512((const __m512i*)&Pairs[i * 2]);
+		EvenSum64x8 = _mm512_add_epi64(
+			EvenSum64x8,
+			_mm512_sad_epu8(
+				_mm512_and_si512(Bytes, _mm512_set1_epi16(0x00FF)),
+				_mm512_setzero_si512()
+			)
+		);
+		OddSum64x8 = _mm512_add_epi64(
+			OddSum64x8,
+			_mm512_sad_epu8(_mm512_srli_epi16(Bytes, 8), _mm512_setzero_si512())
+		);
+	}
+	__m256i EvenSum64x4 = qColorKernel::FoldSum64(EvenSum64x8);
+	__m256i OddSum64x4  = qColorKernel::FoldSum64(OddSum64x8);
+#else
+	__m256i EvenSum64x4 = _mm256_setzero_si256();
+	__m256i OddSum64x4  = _mm256_setzero_si256();
+#endif
+	for( std::size_t j = i/16; j < Count/16; j++, i += 16 )
+	{
+		const __m256i Bytes = _mm256_loadu_si256((const __m256i*)&Pairs[i * 2]);
+		EvenSum64x4 = _mm256_add_epi64(
+			EvenSum64x4,
+			_mm256_sad_epu8(
+				_mm256_and_si256(Bytes, _mm256_set1_epi16(0x00FF)),
+				_mm256_setzero_si256()
+			)
+		);
+		OddSum64x4 = _mm256_add_epi64(
+			OddSum64x4,
+			_mm256_sad_epu8(_mm256_srli_epi16(Bytes, 8), _mm256_setzero_si256())
+		);
+	}
+	alignas(32) std::uint64_t Lanes[2][4];
+	_mm256_store_si256((__m256i*)Lanes[0], EvenSum64x4);
+	_mm256_store_si256((__m256i*)Lanes[1], OddSum64x4);
+	EvenSum = OddSum = 0;
+	for( std::size_t Lane = 0; Lane < 4; ++Lane )
+	{
+		EvenSum += Lanes[0][Lane];
+		OddSum  += Lanes[1][Lane];
+	}
+	for( ; i < Count; ++i )
+	{
+		EvenSum += Pairs[i * 2 + 0];
+		OddSum  += Pairs[i * 2 + 1];
+	}
+}
+
+// Sums of the Y, U and V bytes of Count YUY2 pixel-pairs
+// | VYUYVYUY | VYUYVYUY |
+// | 0Y0Y0Y0Y | 0Y0Y0Y0Y | & 0x00FF
+// | 00U000U0 | 00U000U0 | & 0x0000FF00
+// | 000V000V | 000V000V | >> 24
+void SumYUY2(
+	const std::uint8_t Pairs[], std::size_t Count,
+	std::uint64_t& LumaSum, std::uint64_t& CbSum, std::uint64_t& CrSum
+)
+{
+	std::size_t i = 0;
+	__m256i LumaSum64x4 = _mm256_setzero_si256();
+	__m256i CbSum64x4   = _mm256_setzero_si256();
+	__m256i CrSum64x4   = _mm256_setzero_si256();
+#if defined(__AVX512BW__)
+	__m512i LumaSum64x8 = _mm512_setzero_si512();
+	__m512i CbSum64x8   = _mm512_setzero_si512();
+	__m512i CrSum64x8   = _mm512_setzero_si512();
+	for( std::size_t j = i/16; j < Count/16; j++, i += 16 )
+	{
+		const __m512i Bytes = _mm512_loadu_si512((const __m512i*)&Pairs[i * 4]);
+		LumaSum64x8 = _mm512_add_epi64(
+			LumaSum64x8,
+			_mm512_sad_epu8(
+				_mm512_and_si512(Bytes, _mm512_set1_epi16(0x00FF)),
+				_mm512_setzero_si512()
+			)
+		);
+		CbSum64x8 = _mm512_add_epi64(
+			CbSum64x8,
+			_mm512_sad_epu8(
+				_mm512_and_si512(Bytes, _mm512_set1_epi32(0x0000FF00)),
+				_mm512_setzero_si512()
+			)
+		);
+		CrSum64x8 = _mm512_add_epi64(
+			CrSum64x8,
+			_mm512_sad_epu8(
+				qColorKernel::ShiftRight32<24>(Bytes), _mm512_setzero_si512()
+			)
+		);
+	}
+	LumaSum64x4 = qColorKernel::FoldSum64(LumaSum64x8);
+	CbSum64x4   = qColorKernel::FoldSum64(CbSum64x8);
+	CrSum64x4   = qColorKernel::FoldSum64(CrSum64x8);
+#endif
+	for( std::size_t j = i/8; j < Count/8; j++, i += 8 )
+	{
+		const __m256i Bytes = _mm256_loadu_si256((const __m256i*)&Pairs[i * 4]);
+		LumaSum64x4 = _mm256_add_epi64(
+			LumaSum64x4,
+			_mm256_sad_epu8(
+				_mm256_and_si256(Bytes, _mm256_set1_epi16(0x00FF)),
+				_mm256_setzero_si256()
+			)
+		);
+		// sad_epu8 doesn't care which byte of the group a value is in, so
+		// the Cb bytes can stay where they are
+		CbSum64x4 = _mm256_add_epi64(
+			CbSum64x4,
+			_mm256_sad_epu8(
+				_mm256_and_si256(Bytes, _mm256_set1_epi32(0x0000FF00)),
+				_mm256_setzero_si256()
+			)
+		);
+		CrSum64x4 = _mm256_add_epi64(
+			CrSum64x4,
+			_mm256_sad_epu8(_mm256_srli_epi32(Bytes, 24), _mm256_setzero_si256())
+		);
+	}
+	alignas(32) std::uint64_t Lanes[3][4];
+	_mm256_store_si256((__m256i*)Lanes[0], LumaSum64x4);
+	_mm256_store_si256((__m256i*)Lanes[1], CbSum64x4);
+	_mm256_store_si256((__m256i*)Lanes[2], CrSum64x4);
+	LumaSum = CbSum = CrSum = 0;
+	for( std::size_t Lane = 0; Lane < 4; ++Lane )
+	{
+		LumaSum += Lanes[0][Lane];
+		CbSum   += Lanes[1][Lane];
+		CrSum   += Lanes[2][Lane];
+	}
+	for( ; i < Count; ++i )
+	{
+		LumaSum += Pairs[i * 4 + 0] + Pairs[i * 4 + 2];
+		CbSum   += Pairs[i * 4 + 1];
+		CrSum   += Pairs[i * 4 + 3];
+	}
+}
+
+// The YCbCr to RGB conversion is affine, so the average RGB color is just the
+// conversion of the average Y, Cb, Cr. Only the per-pixel clamping of
+// out-of-gamut colors is lost.
+std::uint32_t YCbCrToRGBA8(
+	double Luma, double Cb, double Cr,
+	qYUVMatrix Matrix, bool FullRange
+)
+{
+	const double Kr = Matrix == qYUVMatrix::BT709 ? 0.2126 : 0.299;
+	const double Kb = Matrix == qYUVMatrix::BT709 ? 0.0722 : 0.114;
+	const double Kg = 1.0 - Kr - Kb;
+
+	if( FullRange )
+	{
+		Cb -= 128.0;
+		Cr -= 128.0;
+	}
+	else
+	{
+		Luma = (Luma - 16.0)  * (255.0 / 219.0);
+		Cb   = (Cb   - 128.0) * (255.0 / 224.0);
+		Cr   = (Cr   - 128.0) * (255.0 / 224.0);
+	}
+
+	const double Red   = Luma + 2.0 * (1.0 - Kr) * Cr;
+	const double Green = Luma - (2.0 * Kb * (1.0 - Kb) / Kg) * Cb
+	                          - (2.0 * Kr * (1.0 - Kr) / Kg) * Cr;
+	const double Blue  = Luma + 2.0 * (1.0 - Kb) * Cb;
+
+	const auto ToUNORM8 = []( double Value ) -> std::uint32_t
+	{
+		return static_cast<std::uint32_t>(
+			std::lround(std::clamp(Value, 0.0, 255.0))
+		);
+	};
+	return
+		(0xFFu            << 24) |
+		(ToUNORM8(Blue)   << 16) |
+		(ToUNORM8(Green)  <<  8) |
+		(ToUNORM8(Red)    <<  0);
+}
+
+}
+
+std::uint32_t qAverageColorNV12(
+	const std::uint8_t LumaPlane[], std::size_t LumaStride,
+	const std::uint8_t ChromaPlane[], std::size_t ChromaStride,
+	std::size_t Width, std::size_t Height,
+	qYUVMatrix Matrix, bool FullRange
+)
+{
+	if( Width == 0 || Height == 0 ) return 0;
+	const std::size_t ChromaWidth  = (Width  + 1) / 2;
+	const std::size_t ChromaHeight = (Height + 1) / 2;
+
+	std::uint64_t LumaSum = 0, CbSum = 0, CrSum = 0;
+	for( std::size_t y = 0; y < Height; ++y )
+	{
+		LumaSum += SumBytes(&LumaPlane[y * LumaStride], Width);
+	}
+	for( std::size_t y = 0; y < ChromaHeight; ++y )
+	{
+		std::uint64_t RowCbSum, RowCrSum;
+		SumBytePairs(&ChromaPlane[y * ChromaStride], ChromaWidth, RowCbSum, RowCrSum);
+		CbSum += RowCbSum;
+		CrSum += RowCrSum;
+	}
+
+	const double ChromaCount = double(ChromaWidth * ChromaHeight);
+	return YCbCrToRGBA8(
+		LumaSum / double(Width * Height),
+		CbSum / ChromaCount, CrSum / ChromaCount,
+		Matrix, FullRange
+	);
+}
+
+std::uint32_t qAverageColorI420(
+	const std::uint8_t LumaPlane[], std::size_t LumaStride,
+	const std::uint8_t CbPlane[], std::size_t CbStride,
+	const std::uint8_t CrPlane[], std::size_t CrStride,
+	std::size_t Width, std::size_t Height,
+	qYUVMatrix Matrix, bool FullRange
+)
+{
+	if( Width == 0 || Height == 0 ) return 0;
+	const std::size_t ChromaWidth  = (Width  + 1) / 2;
+	const std::size_t ChromaHeight = (Height + 1) / 2;
+
+	std::uint64_t LumaSum = 0, CbSum = 0, CrSum = 0;
+	for( std::size_t y = 0; y < Height; ++y )
+	{
+		LumaSum += SumBytes(&LumaPlane[y * LumaStride], Width);
+	}
+	for( std::size_t y = 0; y < ChromaHeight; ++y )
+	{
+		CbSum += SumBytes(&CbPlane[y * CbStride], ChromaWidth);
+		CrSum += SumBytes(&CrPlane[y * CrStride], ChromaWidth);
+	}
+
+	const double ChromaCount = double(ChromaWidth * ChromaHeight);
+	return YCbCrToRGBA8(
+		LumaSum / double(Width * Height),
+		CbSum / ChromaCount, CrSum / ChromaCount,
+		Matrix, FullRange
+	);
+}
+
+std::uint32_t qAverageColorYUY2(
+	const std::uint8_t Pixels[], std::size_t Stride,
+	std::size_t Width, std::size_t Height,
+	qYUVMatrix Matrix, bool FullRange
+)
+{
+	if( Width < 2 || Height == 0 ) return 0;
+	const std::size_t PairCount = Width / 2;
+
+	std::uint64_t LumaSum = 0, CbSum = 0, CrSum = 0;
+	for( std::size_t y = 0; y < Height; ++y )
+	{
+		std::uint64_t RowLumaSum, RowCbSum, RowCrSum;
+		SumYUY2(&Pixels[y * Stride], PairCount, RowLumaSum, RowCbSum, RowCrSum);
+		LumaSum += RowLumaSum;
+		CbSum   += RowCbSum;
+		CrSum   += RowCrSum;
+	}
+
+	const double ChromaCount = double(PairCount * Height);
+	return YCbCrToRGBA8(
+		LumaSum / (ChromaCount * 2.0),
+		CbSum / ChromaCount, CrSum / ChromaCount,
+		Matrix, FullRange
+	);
+}
@@ -0,0 +1,126 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <qAverageColor.hpp>
+#include "Bench.hpp"
+#include "HugePages.hpp"
+
+// Approximate averages from a stratified sample of the pixels, against the
+// exact average. For each fraction: the speedup, the estimate's error against
+// its 95% confidence bound, and how often the true average actually fell
+// within the bound over many different samples
+//
+// The whole image fits in the last-level cache of some machines, so the exact
+// scan and every approximation are timed alike: one untimed warm-up run, then
+// the average of as many timed runs
+
+// 4096 x 4096 image, 64MiB
+constexpr std::size_t ImageWidth  = 4096;
+constexpr std::size_t ImageHeight = 4096;
+constexpr std::size_t ImageSize   = ImageWidth * ImageHeight;
+constexpr double Fractions[] = { 1.0 / 4, 1.0 / 16, 1.0 / 32, 1.0 / 64, 1.0 / 128 };
+constexpr std::size_t Seeds = 200;
+
+template< typename FunctionT >
+double AverageMilliseconds( FunctionT&& Function )
+{
+	Function(0);
+	double Milliseconds = 0.0;
+	for( std::uint32_t Run = 0; Run < Seeds; ++Run )
+	{
+		Milliseconds += Bench<BenchMilliseconds>::BenchTime(Function, Run).count();
+	}
+	return Milliseconds / Seeds;
+}
+
+int main()
+{
+	std::mt19937 Random(0xBEEF);
+	std::normal_distribution<float> Noise(0.0f, 24.0f);
+
+	// Smooth gradients with noise, closer to a photograph than pure noise
+	std::vector<std::uint32_t, PageAllocator<std::uint32_t>> Image(ImageSize);
+	for( std::size_t y = 0; y < ImageHeight; ++y )
+	{
+		for( std::size_t x = 0; x < ImageWidth; ++x )
+		{
+			const auto Channel = [&]( float Value ) -> std::uint32_t
+			{
+				return static_cast<std::uint32_t>(
+					std::fmin(std::fmax(Value + Noise(Random), 0.0f), 255.0f)
+				);
+			};
+			const float u = float(x) / ImageWidth, v = float(y) / ImageHeight;
+			Image[y * ImageWidth + x] =
+				Channel(255.0f * u)
+				| Channel(128.0f + 127.0f * std::sin(6.0f * v)) << 8
+				| Channel(255.0f * u * v) << 16
+				| Channel(255.0f - 64.0f * v) << 24;
+		}
+	}
+
+	qColorSum Exact = {};
+	const double ExactMilliseconds = AverageMilliseconds(
+		[&]( std::uint32_t )
+		{
+			Exact = qSumColorRGBA8Policy(Image.data(), ImageSize, qCachePolicy{});
+		}
+	);
+	const double Truth[4] = {
+		double(Exact.Red)  / ImageSize, double(Exact.Green) / ImageSize,
+		double(Exact.Blue) / ImageSize, double(Exact.Alpha) / ImageSize
+	};
+	std::printf(
+		"Exact: %10.3fms | #%08X\n",
+		ExactMilliseconds, qColorKernel::PackAverageRGBA8(Exact)
+	);
+
+	for( const double Fraction : Fractions )
+	{
+		qColorEstimate Estimate = {};
+		const double Milliseconds = AverageMilliseconds(
+			[&]( std::uint32_t Seed )
+			{
+				Estimate = qAverageColorRGBA8Approximate(
+					Image.data(), ImageSize, Fraction, Seed
+				);
+			}
+		);
+		std::size_t Covered = 0;
+		double WorstError = 0.0, WorstBound = 0.0;
+		for( std::uint32_t Seed = 0; Seed < Seeds; ++Seed )
+		{
+			Estimate = qAverageColorRGBA8Approximate(
+				Image.data(), ImageSize, Fraction, Seed
+			);
+			const double Errors[4] = {
+				Estimate.RedError, Estimate.GreenError,
+				Estimate.BlueError, Estimate.AlphaError
+			};
+			const std::uint64_t Sums[4] = {
+				Estimate.Sum.Red, Estimate.Sum.Green,
+				Estimate.Sum.Blue, Estimate.Sum.Alpha
+			};
+			for( std::size_t Channel = 0; Channel < 4; ++Channel )
+			{
+				const double Error = std::fabs(
+					double(Sums[Channel]) / Estimate.Sum.Count - Truth[Channel]
+				);
+				Covered += Error <= Errors[Channel];
+				WorstError = std::fmax(WorstError, Error);
+				WorstBound = std::fmax(WorstBound, Errors[Channel]);
+			}
+		}
+		std::printf(
+			"1/%-3.0f: %10.3fms | Speedup: %7.3f | #%08X | "
+			"worst error %.3f, bound %.3f | %5.1f%% within bound\n",
+			1.0 / Fraction, Milliseconds, ExactMilliseconds / Milliseconds,
+			Estimate.Average, WorstError, WorstBound,
+			100.0 * Covered / (Seeds * 4)
+		);
+	}
+	return EXIT_SUCCESS;
+}
@@ -1,24 +1,361 @@
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HAS_MMAP
+#endif
 
 #include <qAverageColor.hpp>
 #include "Bench.hpp"
+#include "HugePages.hpp"
+#include "JPEGBands.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+// Binary PPM(P6) and PAM(P7) images are streamed through qColorStream a
+// chunk at a time, so memory use stays at one row no matter how large the
+// image is. Everything else is decoded whole by stb_image.
+struct PNMHeader
+{
+	std::size_t Width, Height, Depth;
+};
+
+// Reads the next whitespace-separated token, skipping # comments
+bool ReadToken( std::FILE* File, char* Token, std::size_t Size )
+{
+	int Char;
+	do
+	{
+		Char = std::fgetc(File);
+		if( Char == '#' )
+		{
+			while( Char != '\n' && Char != EOF ) Char = std::fgetc(File);
+		}
+	} while( Char == ' ' || Char == '\t' || Char == '\r' || Char == '\n' );
+	std::size_t Length = 0;
+	while( Char != EOF && Char != ' ' && Char != '\t' && Char != '\r' && Char != '\n' )
+	{
+		if( Length + 1 < Size ) Token[Length++] = static_cast<char>(Char);
+		Char = std::fgetc(File);
+	}
+	Token[Length] = '\0';
+	// The single whitespace character after the header has been consumed
+	return Length != 0;
+}
+
+// Parses a P6 or P7 header with 8-bit RGB or RGBA samples, leaving the file at
+// the first pixel
+bool ReadPNMHeader( std::FILE* File, PNMHeader& Header )
+{
+	char Token[32];
+	if( !ReadToken(File, Token, sizeof(Token)) ) return false;
+	std::size_t MaxValue = 0;
+	if( std::strcmp(Token, "P6") == 0 )
+	{
+		char Width[32], Height[32], Max[32];
+		if(
+			!ReadToken(File, Width, sizeof(Width))
+			|| !ReadToken(File, Height, sizeof(Height))
+			|| !ReadToken(File, Max, sizeof(Max))
+		) return false;
+		Header.Width  = std::strtoull(Width, nullptr, 10);
+		Header.Height = std::strtoull(Height, nullptr, 10);
+		Header.Depth  = 3;
+		MaxValue      = std::strtoull(Max, nullptr, 10);
+	}
+	else if( std::strcmp(Token, "P7") == 0 )
+	{
+		Header.Width = Header.Height = Header.Depth = 0;
+		while( ReadToken(File, Token, sizeof(Token)) )
+		{
+			if( std::strcmp(Token, "ENDHDR") == 0 ) break;
+			char Value[32];
+			if( !ReadToken(File, Value, sizeof(Value)) ) return false;
+			const std::size_t Number = std::strtoull(Value, nullptr, 10);
+			if( std::strcmp(Token, "WIDTH") == 0 )       Header.Width = Number;
+			else if( std::strcmp(Token, "HEIGHT") == 0 ) Header.Height = Number;
+			else if( std::strcmp(Token, "DEPTH") == 0 )  Header.Depth = Number;
+			else if( std::strcmp(Token, "MAXVAL") == 0 ) MaxValue = Number;
+		}
+	}
+	else
+	{
+		return false;
+	}
+	return MaxValue == 255 && (Header.Depth == 3 || Header.Depth == 4)
+		&& Header.Width != 0 && Header.Height != 0;
+}
+
+// Averages the pixels of the file a row at a time
+bool StreamPNM( std::FILE* File, const PNMHeader& Header, std::uint32_t& Average )
+{
+	if( Header.Depth == 4 )
+	{
+		// RGBA samples are pushed exactly as they are read, rows may be split
+		// at any byte
+		qColorStream<qChannelOrder::RGBA> Stream;
+		std::vector<std::uint8_t> Chunk(Header.Width * 4);
+		std::size_t Remaining = Header.Width * Header.Height * 4;
+		while( Remaining != 0 )
+		{
+			const std::size_t Read = std::fread(
+				Chunk.data(), 1, std::min(Chunk.size(), Remaining), File
+			);
+			if( Read == 0 ) return false;
+			Stream.PushBytes(Chunk.data(), Read);
+			Remaining -= Read;
+		}
+		Average = Stream.Average();
+		return true;
+	}
+
+	// RGB samples are padded out into RGBX pixels a row at a time
+	qColorStream<qChannelOrder::RGBX> Stream;
+	std::vector<std::uint8_t> Row(Header.Width * 3);
+	std::vector<std::uint32_t> Pixels(Header.Width);
+	for( std::size_t y = 0; y < Header.Height; ++y )
+	{
+		if( std::fread(Row.data(), 1, Row.size(), File) != Row.size() ) return false;
+		for( std::size_t x = 0; x < Header.Width; ++x )
+		{
+			Pixels[x] =
+				(static_cast<std::uint32_t>(Row[x * 3 + 0]) <<  0) |
+				(static_cast<std::uint32_t>(Row[x * 3 + 1]) <<  8) |
+				(static_cast<std::uint32_t>(Row[x * 3 + 2]) << 16);
+		}
+		Stream.Push(Pixels.data(), Pixels.size());
+	}
+	Average = Stream.Average();
+	return true;
+}
+
+// Raw RGBA8 dumps have no header at all, every 4 bytes of the file is a pixel
+// and any trailing partial pixel is ignored
+
+// Reads the whole file into a buffer before averaging it. The buffer is an
+// ordinary heap allocation, or backed by huge pages when HugePages is set
+bool AverageRawRead( const char* Path, bool HugePages, std::uint32_t& Average )
+{
+	// 64-bit, unlike ftell's long on Windows
+	std::error_code Error;
+	const std::uintmax_t Size = std::filesystem::file_size(Path, Error);
+	if( Error || Size < 4 ) return false;
+	std::FILE* File = std::fopen(Path, "rb");
+	if( File == nullptr ) return false;
+	// Left uninitialized, so that only the copy out of the page cache is timed
+	const std::size_t Count = static_cast<std::size_t>(Size) / 4;
+	std::uint32_t* Pixels = HugePages
+		? static_cast<std::uint32_t*>(
+			AllocatePages(Count * sizeof(std::uint32_t), PageSize::Huge)
+		)
+		: new std::uint32_t[Count];
+	const std::size_t Read = std::fread(
+		Pixels, sizeof(std::uint32_t), Count, File
+	);
+	std::fclose(File);
+	if( Read == Count ) Average = qAverageColorRGBA8(Pixels, Count);
+	if( HugePages ) FreePages(Pixels, Count * sizeof(std::uint32_t));
+	else delete[] Pixels;
+	return Read == Count;
+}
+
+#ifdef HAS_MMAP
+// Maps the file and averages the mapping in-place, without any copies. The
+// pages are faulted in up-front(MAP_POPULATE, Linux only) rather than one at
+// a time during the scan. Elsewhere, the kernel is told that the mapping is
+// read sequentially so it can at least read-ahead aggressively
+bool AverageRawMapped( const char* Path, std::uint32_t& Average )
+{
+	const int File = open(Path, O_RDONLY);
+	if( File < 0 ) return false;
+	struct stat Status;
+	if( fstat(File, &Status) != 0 || Status.st_size < 4 )
+	{
+		close(File);
+		return false;
+	}
+	const std::size_t Size = static_cast<std::size_t>(Status.st_size);
+#ifdef MAP_POPULATE
+	void* Mapping = mmap(
+		nullptr, Size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, File, 0
+	);
+	close(File);
+	if( Mapping == MAP_FAILED ) return false;
+#else
+	void* Mapping = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, File, 0);
+	close(File);
+	if( Mapping == MAP_FAILED ) return false;
+	madvise(Mapping, Size, MADV_SEQUENTIAL);
+#endif
+	Average = qAverageColorRGBA8(
+		static_cast<const std::uint32_t*>(Mapping), Size / 4
+	);
+	munmap(Mapping, Size);
+	return true;
+}
+#endif
+
+// The default comparison is mmap against read() into an ordinary buffer.
+// HugePages adds read() into a huge-page buffer as a third variant
+int AverageRaw( const char* Path, bool Compare, bool HugePages )
+{
+	std::uint32_t Average = 0;
+#ifdef HAS_MMAP
+	const auto Mapped = Bench<>::BenchResult(AverageRawMapped, Path, Average);
+	if( !std::get<1>(Mapped) )
+	{
+		std::puts("Error mapping image");
+		return EXIT_FAILURE;
+	}
+	std::printf(
+		"Mapped: #%08X | %12zuns\n",
+		Average,
+		std::get<0>(Mapped).count()
+	);
+	if( !Compare && !HugePages ) return EXIT_SUCCESS;
+#else
+	// No mmap, the read() path is all there is
+	(void)Compare;
+#endif
+	const auto Read = Bench<>::BenchResult(AverageRawRead, Path, false, Average);
+	if( !std::get<1>(Read) )
+	{
+		std::puts("Error reading image");
+		return EXIT_FAILURE;
+	}
+	std::printf(
+		"Read  : #%08X | %12zuns\n",
+		Average,
+		std::get<0>(Read).count()
+	);
+#ifdef HAS_MMAP
+	std::printf(
+		"Mapped Speedup: %f\n",
+		std::get<0>(Read).count() / static_cast<double>(std::get<0>(Mapped).count())
+	);
+#endif
+	if( !HugePages ) return EXIT_SUCCESS;
+
+	const auto Huge = Bench<>::BenchResult(AverageRawRead, Path, true, Average);
+	if( !std::get<1>(Huge) )
+	{
+		std::puts("Error reading image");
+		return EXIT_FAILURE;
+	}
+	std::printf(
+		"Huge  : #%08X | %12zuns\n",
+		Average,
+		std::get<0>(Huge).count()
+	);
+	std::printf(
+		"Huge Speedup: %f\n",
+		std::get<0>(Read).count() / static_cast<double>(std::get<0>(Huge).count())
+	);
+	return EXIT_SUCCESS;
+}
+
+// Only JPEGs can take the banded path, which needs the whole encoded file
+bool IsJPEG( const char* Path )
+{
+	std::FILE* File = std::fopen(Path, "rb");
+	if( File == nullptr ) return false;
+	std::uint8_t Magic[2] = {};
+	const bool JPEG = std::fread(Magic, 1, 2, File) == 2
+		&& Magic[0] == 0xFF && Magic[1] == 0xD8;
+	std::fclose(File);
+	return JPEG;
+}
+
+bool ReadFile( const char* Path, std::vector<std::uint8_t>& Contents )
+{
+	std::error_code Error;
+	const std::uintmax_t Size = std::filesystem::file_size(Path, Error);
+	if( Error ) return false;
+	std::FILE* File = std::fopen(Path, "rb");
+	if( File == nullptr ) return false;
+	Contents.resize(static_cast<std::size_t>(Size));
+	Contents.resize(std::fread(Contents.data(), 1, Contents.size(), File));
+	std::fclose(File);
+	return !Contents.empty();
+}
+
 int main( int argc, char* argv[])
 {
+	if( argc < 2 )
+	{
+		std::puts("Usage: AverageColor <image>");
+		std::puts("       AverageColor --raw <rgba8 dump> [--compare] [--huge-pages]");
+		return EXIT_FAILURE;
+	}
+
+	if( std::strcmp(argv[1], "--raw") == 0 )
+	{
+		if( argc < 3 )
+		{
+			std::puts("Usage: AverageColor --raw <rgba8 dump> [--compare] [--huge-pages]");
+			return EXIT_FAILURE;
+		}
+		bool Compare = false, HugePages = false;
+		for( int i = 3; i < argc; ++i )
+		{
+			Compare   |= std::strcmp(argv[i], "--compare") == 0;
+			HugePages |= std::strcmp(argv[i], "--huge-pages") == 0;
+		}
+		return AverageRaw(argv[2], Compare, HugePages);
+	}
+
+	if( std::FILE* File = std::fopen(argv[1], "rb") )
+	{
+		PNMHeader Header;
+		if( ReadPNMHeader(File, Header) )
+		{
+			std::uint32_t Average = 0;
+			const auto Stream = Bench<>::BenchResult(
+				StreamPNM, File, Header, Average
+			);
+			std::fclose(File);
+			if( !std::get<1>(Stream) )
+			{
+				std::puts("Error reading image");
+				return EXIT_FAILURE;
+			}
+			std::printf(
+				"Stream: #%08X | %12zuns\n",
+				Average,
+				std::get<0>(Stream).count()
+			);
+			return EXIT_SUCCESS;
+		}
+		std::fclose(File);
+	}
+
 	std::int32_t Width, Height, Channels;
 	Width = Height = Channels = 0;
-	std::uint8_t* Pixels = stbi_load(
+	const auto Decode = Bench<>::BenchResult(
+		stbi_load,
 		argv[1],
 		&Width, &Height, &Channels, 4
 	);
+	std::uint8_t* Pixels = std::get<1>(Decode);
 	if( Pixels == nullptr )
 	{
 		std::puts("Error loading image");
 		return EXIT_FAILURE;
 	}
+	std::printf(
+		"Decode: %22zuns\n",
+		std::get<0>(Decode).count()
+	);
 
 	const auto Serial = Bench<>::BenchResult(
 		AverageColorRGBA8,
@@ -47,5 +384,39 @@ int main( int argc, char* argv[])
 	);
 
 	stbi_image_free(Pixels);
+
+	// Restart-interval JPEGs can also be decoded and averaged in parallel
+	// bands, without ever holding the whole decoded image. Only this path
+	// reads the file whole, once the decoded image above has been freed, and
+	// that read is timed along with it.
+	// Subsampled(4:2:x) JPEGs are left to the whole-image decode above, as
+	// their bands would not upsample chroma across the seams the same way
+	if( !IsJPEG(argv[1]) ) return EXIT_SUCCESS;
+	qColorSum BandSum;
+	const auto Bands = Bench<>::BenchResult(
+		[]( const char* Path, qColorSum& Sum )
+		{
+			std::vector<std::uint8_t> Encoded;
+			return ReadFile(Path, Encoded) && SumJPEGBands(
+				Encoded.data(), Encoded.size(),
+				static_cast<std::size_t>(std::max(1u, std::thread::hardware_concurrency())),
+				Sum
+			);
+		},
+		argv[1], BandSum
+	);
+	if( std::get<1>(Bands) )
+	{
+		std::printf(
+			"Bands : #%08X | %12zuns\n",
+			qColorKernel::PackAverageRGBA8(BandSum),
+			std::get<0>(Bands).count()
+		);
+		std::printf(
+			"Bands Speedup: %f\n",
+			(std::get<0>(Decode) + std::get<0>(Fast)).count()
+				/ static_cast<double>(std::get<0>(Bands).count())
+		);
+	}
 	return EXIT_SUCCESS;
 }
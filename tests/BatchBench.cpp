@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <qAverageColor.hpp>
+#include "Bench.hpp"
+
+// Scaling of batch averaging over a batch that mixes icons with 8K frames,
+// from one thread up to every hardware thread.
+//  - Static: every thread takes an equal share of the images, in order
+//  - Stealing: qSumColorRGBA8BatchParallel
+
+constexpr std::size_t IconCount  = 65536;
+constexpr std::size_t IconSize   = 16 * 16;
+constexpr std::size_t FrameCount = 2;
+constexpr std::size_t FrameSize  = 7680 * 4320;
+
+void SumStatic(
+	const std::uint32_t* const Images[], const std::size_t Counts[],
+	std::size_t ImageCount, qColorSum Sums[], std::size_t ThreadCount
+)
+{
+	std::vector<std::thread> Threads;
+	for( std::size_t i = 0; i < ThreadCount; ++i )
+	{
+		Threads.emplace_back(
+			[=]()
+			{
+				const std::size_t First = i * ImageCount / ThreadCount;
+				const std::size_t Last  = (i + 1) * ImageCount / ThreadCount;
+				qSumColorRGBA8Batch(
+					&Images[First], &Counts[First], Last - First, &Sums[First]
+				);
+			}
+		);
+	}
+	for( std::thread& Thread : Threads ) Thread.join();
+}
+
+int main( int argc, char* argv[])
+{
+	const std::size_t MaxThreads = argc > 1
+		? std::strtoull(argv[1], nullptr, 10)
+		: std::max(1u, std::thread::hardware_concurrency());
+
+	// Frames land wherever the shuffle puts them, as they would in a real
+	// batch
+	std::vector<std::vector<std::uint32_t>> Storage;
+	for( std::size_t i = 0; i < IconCount; ++i )
+	{
+		Storage.emplace_back(IconSize, 0xBEEFFEEB);
+	}
+	for( std::size_t i = 0; i < FrameCount; ++i )
+	{
+		Storage.emplace_back(FrameSize, 0xBEEFFEEB);
+	}
+	std::shuffle(Storage.begin(), Storage.end(), std::mt19937(0xBEEF));
+
+	std::vector<const std::uint32_t*> Images;
+	std::vector<std::size_t> Counts;
+	for( const auto& Image : Storage )
+	{
+		Images.push_back(Image.data());
+		Counts.push_back(Image.size());
+	}
+	std::vector<qColorSum> Sums(Images.size());
+
+	std::printf(
+		"%zu %zu-pixel icons, %zu %zu-pixel frames\n",
+		IconCount, IconSize, FrameCount, FrameSize
+	);
+	const double Serial = Bench<BenchMilliseconds>::BenchTime(
+		[&]()
+		{
+			qSumColorRGBA8Batch(
+				Images.data(), Counts.data(), Images.size(), Sums.data()
+			);
+		}
+	).count();
+	std::printf("Serial: %10.3fms\n", Serial);
+	// Powers of two, and then every thread
+	std::vector<std::size_t> ThreadCounts;
+	for( std::size_t Threads = 1; Threads < MaxThreads; Threads *= 2 )
+	{
+		ThreadCounts.push_back(Threads);
+	}
+	ThreadCounts.push_back(MaxThreads);
+	for( const std::size_t Threads : ThreadCounts )
+	{
+		const double Static = Bench<BenchMilliseconds>::BenchTime(
+			[&]()
+			{
+				SumStatic(
+					Images.data(), Counts.data(), Images.size(), Sums.data(), Threads
+				);
+			}
+		).count();
+		const double Stealing = Bench<BenchMilliseconds>::BenchTime(
+			[&]()
+			{
+				qSumColorRGBA8BatchParallel(
+					Images.data(), Counts.data(), Images.size(), Sums.data(), Threads
+				);
+			}
+		).count();
+		std::printf(
+			"%3zu threads | Static: %10.3fms (x%6.3f) | Stealing: %10.3fms (x%6.3f)"
+			" | #%08X\n",
+			Threads, Static, Serial / Static, Stealing, Serial / Stealing,
+			qColorKernel::PackAverageRGBA8(Sums.back())
+		);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,326 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <qAverageColor.hpp>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+// Averages every image file under a set of directories. Files named on the
+// command line are always tried, files found by walking a directory only if
+// their extension is one that stb_image decodes.
+// Reading, decoding and averaging each run on their own pool of threads,
+// connected by bounded queues:
+//
+// Walk -> | Paths | -> Read -> | Files | -> Decode -> | Images | -> Average
+//
+// so that disk reads, decoding and summing of different files overlap, while
+// the bounds keep at most a few files of each stage in memory at once.
+
+// Multi-producer, multi-consumer queue. Push blocks while the queue is full and
+// Pop blocks while it is empty, until the queue is closed
+template< typename T >
+class BoundedQueue
+{
+public:
+	explicit BoundedQueue( std::size_t Capacity ) : Capacity(Capacity)
+	{
+	}
+
+	void Push( T&& Item )
+	{
+		std::unique_lock<std::mutex> Lock(Mutex);
+		NotFull.wait(Lock, [&]{ return Items.size() < Capacity; });
+		Items.push_back(std::move(Item));
+		NotEmpty.notify_one();
+	}
+
+	// Returns nothing once the queue is closed and drained
+	std::optional<T> Pop()
+	{
+		std::unique_lock<std::mutex> Lock(Mutex);
+		NotEmpty.wait(Lock, [&]{ return !Items.empty() || Closed; });
+		if( Items.empty() ) return std::nullopt;
+		T Item = std::move(Items.front());
+		Items.pop_front();
+		NotFull.notify_one();
+		return Item;
+	}
+
+	// No more items will be pushed
+	void Close()
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		Closed = true;
+		NotEmpty.notify_all();
+	}
+
+private:
+	const std::size_t Capacity;
+	std::deque<T> Items;
+	bool Closed = false;
+	std::mutex Mutex;
+	std::condition_variable NotEmpty, NotFull;
+};
+
+struct EncodedFile
+{
+	std::filesystem::path Path;
+	std::vector<std::uint8_t> Bytes;
+};
+
+struct DecodedImage
+{
+	std::filesystem::path Path;
+	std::unique_ptr<std::uint8_t, void(*)(void*)> Pixels{nullptr, stbi_image_free};
+	std::size_t Count;
+};
+
+// Runs Count copies of Stage on their own threads, and closes Output once all
+// of them have returned
+template< typename StageT, typename OutputT >
+std::thread RunStage( std::size_t Count, StageT Stage, OutputT& Output )
+{
+	return std::thread(
+		[Count, Stage, &Output]()
+		{
+			std::vector<std::thread> Workers;
+			for( std::size_t i = 0; i < Count; ++i ) Workers.emplace_back(Stage);
+			for( std::thread& Worker : Workers ) Worker.join();
+			Output.Close();
+		}
+	);
+}
+
+bool HasImageExtension( const std::filesystem::path& Path )
+{
+	std::string Extension = Path.extension().string();
+	std::transform(
+		Extension.begin(), Extension.end(), Extension.begin(),
+		[]( unsigned char Char ) { return static_cast<char>(std::tolower(Char)); }
+	);
+	for(
+		const char* Known : {
+			".jpg", ".jpeg", ".png", ".bmp", ".tga", ".gif", ".psd", ".hdr",
+			".pic", ".pgm", ".ppm", ".pnm"
+		}
+	)
+	{
+		if( Extension == Known ) return true;
+	}
+	return false;
+}
+
+bool ReadFile( const std::filesystem::path& Path, std::vector<std::uint8_t>& Bytes )
+{
+	std::error_code Error;
+	const std::uintmax_t Size = std::filesystem::file_size(Path, Error);
+	if( Error || Size == 0 ) return false;
+	std::FILE* File = std::fopen(Path.string().c_str(), "rb");
+	if( File == nullptr ) return false;
+	Bytes.resize(static_cast<std::size_t>(Size));
+	const std::size_t Read = std::fread(Bytes.data(), 1, Bytes.size(), File);
+	std::fclose(File);
+	return Read == Bytes.size();
+}
+
+int main( int argc, char* argv[])
+{
+	const std::size_t Cores = std::max(1u, std::thread::hardware_concurrency());
+	// Decoding is by far the slowest stage, so it gets most of the cores
+	std::size_t Readers   = 2;
+	std::size_t Decoders  = Cores;
+	std::size_t Averagers = 1;
+	std::vector<std::filesystem::path> Roots;
+	for( int i = 1; i < argc; ++i )
+	{
+		if( std::strcmp(argv[i], "--readers") == 0 && i + 1 < argc )
+		{
+			Readers = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if( std::strcmp(argv[i], "--decoders") == 0 && i + 1 < argc )
+		{
+			Decoders = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if( std::strcmp(argv[i], "--averagers") == 0 && i + 1 < argc )
+		{
+			Averagers = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+		}
+		else
+		{
+			Roots.emplace_back(argv[i]);
+		}
+	}
+	if( Roots.empty() )
+	{
+		std::puts(
+			"Usage: BatchColor [--readers N] [--decoders N] [--averagers N] "
+			"<directory|file>..."
+		);
+		return EXIT_FAILURE;
+	}
+
+	// Each queue holds a couple of items per consumer so that no consumer
+	// starves while its producers are busy
+	BoundedQueue<std::filesystem::path> Paths(Readers * 4);
+	BoundedQueue<EncodedFile>           Files(Decoders * 2);
+	BoundedQueue<DecodedImage>          Images(Averagers * 2);
+
+	std::mutex OutputMutex;
+	std::size_t Averaged = 0, Skipped = 0, Failed = 0;
+	std::uint64_t PixelsAveraged = 0;
+	const auto Fail = [&]( const std::filesystem::path& Path )
+	{
+		std::lock_guard<std::mutex> Lock(OutputMutex);
+		std::fprintf(stderr, "Error loading %s\n", Path.string().c_str());
+		++Failed;
+	};
+
+	const auto Start = std::chrono::high_resolution_clock::now();
+
+	std::thread ReadStage = RunStage(
+		Readers,
+		[&]()
+		{
+			while( std::optional<std::filesystem::path> Path = Paths.Pop() )
+			{
+				EncodedFile File{std::move(*Path), {}};
+				if( !ReadFile(File.Path, File.Bytes) )
+				{
+					Fail(File.Path);
+					continue;
+				}
+				Files.Push(std::move(File));
+			}
+		},
+		Files
+	);
+
+	std::thread DecodeStage = RunStage(
+		Decoders,
+		[&]()
+		{
+			while( std::optional<EncodedFile> File = Files.Pop() )
+			{
+				int Width, Height, Channels;
+				DecodedImage Image;
+				Image.Path = std::move(File->Path);
+				// Files that stb_image does not recognize at all are not images,
+				// rather than images that failed to load
+				if(
+					!stbi_info_from_memory(
+						File->Bytes.data(), static_cast<int>(File->Bytes.size()),
+						&Width, &Height, &Channels
+					)
+				)
+				{
+					std::lock_guard<std::mutex> Lock(OutputMutex);
+					std::fprintf(stderr, "Skipping %s\n", Image.Path.string().c_str());
+					++Skipped;
+					continue;
+				}
+				Image.Pixels.reset(
+					stbi_load_from_memory(
+						File->Bytes.data(), static_cast<int>(File->Bytes.size()),
+						&Width, &Height, &Channels, 4
+					)
+				);
+				// Free the encoded bytes before waiting on the next stage
+				File.reset();
+				if( Image.Pixels == nullptr )
+				{
+					Fail(Image.Path);
+					continue;
+				}
+				Image.Count = static_cast<std::size_t>(Width) * Height;
+				Images.Push(std::move(Image));
+			}
+		},
+		Images
+	);
+
+	// Averagers have no output queue, so they close a queue of their own
+	BoundedQueue<int> Done(1);
+	std::thread AverageStage = RunStage(
+		Averagers,
+		[&]()
+		{
+			while( std::optional<DecodedImage> Image = Images.Pop() )
+			{
+				const std::uint32_t Average = qAverageColorRGBA8(
+					reinterpret_cast<const std::uint32_t*>(Image->Pixels.get()),
+					Image->Count
+				);
+				std::lock_guard<std::mutex> Lock(OutputMutex);
+				std::printf("#%08X %s\n", Average, Image->Path.string().c_str());
+				++Averaged;
+				PixelsAveraged += Image->Count;
+			}
+		},
+		Done
+	);
+
+	// Walk
+	for( const std::filesystem::path& Root : Roots )
+	{
+		std::error_code RootError;
+		if( std::filesystem::is_regular_file(Root, RootError) )
+		{
+			Paths.Push(std::filesystem::path(Root));
+			continue;
+		}
+		// Only errors of the walk itself end it, an entry that can not be
+		// inspected is passed over
+		std::error_code WalkError;
+		for(
+			std::filesystem::recursive_directory_iterator Entry(
+				Root, std::filesystem::directory_options::skip_permission_denied,
+				WalkError
+			), End;
+			Entry != End;
+			Entry.increment(WalkError)
+		)
+		{
+			std::error_code EntryError;
+			if( Entry->is_regular_file(EntryError) && HasImageExtension(Entry->path()) )
+			{
+				Paths.Push(std::filesystem::path(Entry->path()));
+			}
+		}
+		if( WalkError )
+		{
+			std::fprintf(
+				stderr, "Error walking %s: %s\n",
+				Root.string().c_str(), WalkError.message().c_str()
+			);
+		}
+	}
+	Paths.Close();
+
+	ReadStage.join();
+	DecodeStage.join();
+	AverageStage.join();
+
+	const auto Stop = std::chrono::high_resolution_clock::now();
+	const double Seconds = std::chrono::duration<double>(Stop - Start).count();
+	std::fprintf(
+		stderr,
+		"%zu averaged, %zu skipped, %zu failed | %fs | %f images/s | %f megapixels/s\n",
+		Averaged, Skipped, Failed, Seconds,
+		Averaged / Seconds, PixelsAveraged / Seconds / 1'000'000.0
+	);
+	return Failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -2,6 +2,9 @@
 #include <tuple>
 #include <chrono>
 
+// Fractional milliseconds, for printing timings with
+using BenchMilliseconds = std::chrono::duration<double, std::milli>;
+
 template< typename TimeT = std::chrono::nanoseconds >
 struct Bench
 {
@@ -27,4 +30,15 @@ struct Bench
 			std::move(ReturnValue)
 		);
 	}
+
+	// Returns just the time, for functions with no return value
+	template< typename FunctionT, typename ...ArgsT >
+	static TimeT BenchTime( FunctionT&& Func, ArgsT&&... Arguments )
+	{
+		const auto Start = std::chrono::high_resolution_clock::now();
+		std::forward<FunctionT>(Func)(std::forward<ArgsT>(Arguments)...);
+		const auto Stop = std::chrono::high_resolution_clock::now();
+
+		return std::chrono::duration_cast<TimeT>(Stop - Start);
+	}
 };
\ No newline at end of file
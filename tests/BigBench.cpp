@@ -3,16 +3,58 @@
 
 #include <qAverageColor.hpp>
 #include "Bench.hpp"
+#include "HugePages.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <vector>
 
 // 10 megapixels
 constexpr std::size_t PixelCount = 10'000'000;
 constexpr std::uint32_t TestValue = 0xBEEFFEEB;
 
+// Best of several runs of qAverageColorRGBA8 over the same pixels backed by
+// 4KiB pages and by 2MiB pages
+int ComparePages()
+{
+	constexpr std::size_t Runs = 16;
+	for( const PageSize Pages : { PageSize::Small, PageSize::Huge } )
+	{
+		PageBacking Backing;
+		std::uint32_t* Pixels = static_cast<std::uint32_t*>(
+			AllocatePages(PixelCount * sizeof(std::uint32_t), Pages, &Backing)
+		);
+		std::fill_n(Pixels, PixelCount, TestValue);
+		auto Best = std::get<0>(
+			Bench<>::BenchResult(qAverageColorRGBA8, Pixels, PixelCount)
+		);
+		std::uint32_t Average = 0;
+		for( std::size_t i = 1; i < Runs; ++i )
+		{
+			const auto Result = Bench<>::BenchResult(
+				qAverageColorRGBA8, Pixels, PixelCount
+			);
+			Best = std::min(Best, std::get<0>(Result));
+			Average = std::get<1>(Result);
+		}
+		std::printf(
+			"%-26s: #%08X | %12zuns | %f GB/s\n",
+			PageBackingName(Backing), Average, Best.count(),
+			PixelCount * sizeof(std::uint32_t) / static_cast<double>(Best.count())
+		);
+		FreePages(Pixels, PixelCount * sizeof(std::uint32_t));
+	}
+	return EXIT_SUCCESS;
+}
+
 int  main( int argc, char* argv[])
 {
-	std::vector<std::uint32_t> TestPixels(
+	if( argc > 1 && std::strcmp(argv[1], "--pages") == 0 )
+	{
+		return ComparePages();
+	}
+
+	const std::vector<std::uint32_t, PageAllocator<std::uint32_t>> TestPixels(
 		PixelCount,
 		TestValue
 	);
@@ -43,5 +85,53 @@ int  main( int argc, char* argv[])
 		std::get<0>(Serial).count() / static_cast<double>(std::get<0>(Fast).count())
 	);
 
+	// Same pixels, with the alpha byte treated as padding
+	const auto FastRGBX = Bench<>::BenchResult(
+		qAverageColor<qChannelOrder::RGBX>,
+		TestPixels.data(),
+		PixelCount
+	);
+	std::printf(
+		"RGBX  : #%08X | %12zuns\n",
+		std::get<1>(FastRGBX),
+		std::get<0>(FastRGBX).count()
+	);
+	std::printf(
+		"RGBX Speedup: %f\n",
+		std::get<0>(Fast).count() / static_cast<double>(std::get<0>(FastRGBX).count())
+	);
+
+	// All hardware threads, and all hardware threads of the node that owns
+	// each chunk
+	const auto Parallel = Bench<>::BenchResult(
+		qAverageColorRGBA8Parallel,
+		TestPixels.data(),
+		PixelCount,
+		std::size_t(0)
+	);
+	std::printf(
+		"Parallel: #%08X | %12zuns\n",
+		std::get<1>(Parallel),
+		std::get<0>(Parallel).count()
+	);
+	const auto NUMA = Bench<>::BenchResult(
+		qAverageColorRGBA8NUMA,
+		TestPixels.data(),
+		PixelCount
+	);
+	std::printf(
+		"NUMA    : #%08X | %12zuns\n",
+		std::get<1>(NUMA),
+		std::get<0>(NUMA).count()
+	);
+	std::printf(
+		"Parallel Speedup: %f\n",
+		std::get<0>(Fast).count() / static_cast<double>(std::get<0>(Parallel).count())
+	);
+	std::printf(
+		"NUMA Speedup: %f\n",
+		std::get<0>(Fast).count() / static_cast<double>(std::get<0>(NUMA).count())
+	);
+
 	return EXIT_SUCCESS;
 }
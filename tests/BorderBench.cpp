@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <qAverageColor.hpp>
+#include "Bench.hpp"
+#include "HugePages.hpp"
+
+// Ambient-light border zones of a frame, one qAverageColorRGBA8Rect call per
+// zone against a single qAverageColorBorder pass over the frame
+
+struct Layout
+{
+	std::size_t Width, Height;
+	std::size_t Depth;
+	std::size_t HorizontalZones, VerticalZones;
+};
+
+constexpr Layout Layouts[] = {
+	{ 1920, 1080,  32, 16,  9 },
+	{ 1920, 1080, 128, 32, 18 },
+	{ 3840, 2160,  64, 16,  9 },
+	{ 3840, 2160, 256, 64, 36 }
+};
+constexpr std::size_t FrameCount = 240;
+
+int main()
+{
+	std::mt19937 Random(0xBEEF);
+
+	for( const Layout& Frame : Layouts )
+	{
+		std::vector<std::uint32_t, PageAllocator<std::uint32_t>> Pixels(
+			Frame.Width * Frame.Height
+		);
+		for( std::uint32_t& Pixel : Pixels ) Pixel = Random();
+		const std::size_t Stride = Frame.Width * sizeof(std::uint32_t);
+		const std::size_t Rows    = std::min(Frame.Depth, Frame.Height / 2);
+		const std::size_t Columns = std::min(Frame.Depth, Frame.Width / 2);
+
+		// The same zones, clockwise from the top-left
+		std::vector<qRect> Zones;
+		const auto Horizontal = [&]( std::size_t Zone, std::size_t y )
+		{
+			const std::size_t Begin = Zone * Frame.Width / Frame.HorizontalZones;
+			const std::size_t End   = (Zone + 1) * Frame.Width / Frame.HorizontalZones;
+			Zones.push_back(qRect{ Begin, y, End - Begin, Rows });
+		};
+		const auto Vertical = [&]( std::size_t Zone, std::size_t x )
+		{
+			const std::size_t VerticalZones = Frame.VerticalZones;
+			const std::size_t Begin = (Zone * Frame.Height + VerticalZones - 1) / VerticalZones;
+			const std::size_t End   = ((Zone + 1) * Frame.Height + VerticalZones - 1) / VerticalZones;
+			Zones.push_back(qRect{ x, Begin, Columns, End - Begin });
+		};
+		for( std::size_t Zone = 0; Zone < Frame.HorizontalZones; ++Zone )
+		{
+			Horizontal(Zone, 0);
+		}
+		for( std::size_t Zone = 0; Zone < Frame.VerticalZones; ++Zone )
+		{
+			Vertical(Zone, Frame.Width - Columns);
+		}
+		for( std::size_t Zone = Frame.HorizontalZones; Zone-- > 0; )
+		{
+			Horizontal(Zone, Frame.Height - Rows);
+		}
+		for( std::size_t Zone = Frame.VerticalZones; Zone-- > 0; )
+		{
+			Vertical(Zone, 0);
+		}
+
+		std::vector<std::uint32_t> Expected(Zones.size());
+		const double RectMilliseconds = Bench<BenchMilliseconds>::BenchTime(
+			[&]()
+			{
+				for( std::size_t i = 0; i < FrameCount; ++i )
+				{
+					for( std::size_t Zone = 0; Zone < Zones.size(); ++Zone )
+					{
+						Expected[Zone] = qAverageColorRGBA8Rect(
+							&Pixels[Zones[Zone].Y * Frame.Width + Zones[Zone].X],
+							Stride, Zones[Zone].Width, Zones[Zone].Height
+						);
+					}
+				}
+			}
+		).count() / FrameCount;
+
+		std::vector<std::uint32_t> Averages(Zones.size());
+		const double BorderMilliseconds = Bench<BenchMilliseconds>::BenchTime(
+			[&]()
+			{
+				for( std::size_t i = 0; i < FrameCount; ++i )
+				{
+					qAverageColorBorder(
+						Pixels.data(), Stride, Frame.Width, Frame.Height, Frame.Depth,
+						Frame.HorizontalZones, Frame.VerticalZones, Averages.data()
+					);
+				}
+			}
+		).count() / FrameCount;
+
+		std::size_t Mismatches = 0;
+		for( std::size_t Zone = 0; Zone < Zones.size(); ++Zone )
+		{
+			Mismatches += Averages[Zone] != Expected[Zone];
+		}
+		std::printf(
+			"%zux%zu, %zu zones %zu deep\n"
+			"\tPer-zone: %8.3fms/frame\n"
+			"\tBorder  : %8.3fms/frame | Speedup: %f | %zu mismatches\n",
+			Frame.Width, Frame.Height, Zones.size(), Frame.Depth,
+			RectMilliseconds, BorderMilliseconds,
+			RectMilliseconds / BorderMilliseconds, Mismatches
+		);
+	}
+	return EXIT_SUCCESS;
+}
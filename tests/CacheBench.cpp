@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <qAverageColor.hpp>
+#include "HugePages.hpp"
+
+// Effect of each qCachePolicy on a co-running, cache-sensitive workload.
+// One thread chases pointers around a working set that fits in the
+// last-level cache while another thread keeps averaging a buffer that is
+// far larger than it. The more of the scan that lands in the shared cache,
+// the more of the working set gets evicted and the slower the chase gets.
+//
+// CacheBench [working set MiB] [scan MiB]
+
+// 512 MiB of pixels to scan
+constexpr std::size_t DefaultScanMiB = 512;
+// Fits within the last-level cache of most desktop parts
+constexpr std::size_t DefaultWorkingSetMiB = 4;
+constexpr std::size_t ScanPasses = 8;
+
+// Random single-cycle permutation, so that every load depends on the one
+// before it and the hardware prefetchers can not help
+std::vector<std::uint32_t> MakeChain( std::size_t Count )
+{
+	std::vector<std::uint32_t> Order(Count);
+	std::iota(Order.begin(), Order.end(), 0);
+	std::shuffle(Order.begin(), Order.end(), std::mt19937(Count));
+	std::vector<std::uint32_t> Chain(Count);
+	for( std::size_t i = 0; i < Count; ++i )
+	{
+		Chain[Order[i]] = Order[(i + 1) % Count];
+	}
+	return Chain;
+}
+
+struct Result
+{
+	// Pointer-chases per second, of the victim
+	double ChasesPerSecond;
+	// Bytes per second, of the scan
+	double ScanBytesPerSecond;
+	std::uint32_t Average;
+};
+
+// Runs the victim until the scan is done. Without a policy, the victim runs
+// alone for as long as the normal scan took
+Result Run(
+	const std::vector<std::uint32_t>& Chain,
+	const std::vector<std::uint32_t, PageAllocator<std::uint32_t>>& Pixels,
+	const qCachePolicy* Policy,
+	double AloneSeconds
+)
+{
+	std::atomic<bool> Done(false);
+	std::uint64_t Chases = 0;
+	// Keeps the chase from being optimized away
+	volatile std::uint32_t Sink = 0;
+	const auto Start = std::chrono::high_resolution_clock::now();
+	std::thread Victim(
+		[&]()
+		{
+			std::uint32_t Index = 0;
+			while( !Done.load(std::memory_order_relaxed) )
+			{
+				for( std::size_t k = 0; k < 1024; ++k ) Index = Chain[Index];
+				Chases += 1024;
+			}
+			Sink = Index;
+		}
+	);
+
+	Result Measured = {};
+	if( Policy )
+	{
+		for( std::size_t Pass = 0; Pass < ScanPasses; ++Pass )
+		{
+			Measured.Average = qAverageColorRGBA8Policy(
+				Pixels.data(), Pixels.size(), *Policy
+			);
+		}
+	}
+	else
+	{
+		std::this_thread::sleep_for(std::chrono::duration<double>(AloneSeconds));
+	}
+	const auto Stop = std::chrono::high_resolution_clock::now();
+	Done = true;
+	Victim.join();
+
+	const double Seconds = std::chrono::duration<double>(Stop - Start).count();
+	Measured.ChasesPerSecond = Chases / Seconds;
+	Measured.ScanBytesPerSecond =
+		ScanPasses * Pixels.size() * sizeof(std::uint32_t) / Seconds;
+	return Measured;
+}
+
+int main( int argc, char* argv[])
+{
+	const std::size_t WorkingSetMiB = argc > 1
+		? std::strtoull(argv[1], nullptr, 10) : DefaultWorkingSetMiB;
+	const std::size_t ScanMiB = argc > 2
+		? std::strtoull(argv[2], nullptr, 10) : DefaultScanMiB;
+
+	const std::vector<std::uint32_t> Chain = MakeChain(
+		WorkingSetMiB * 1024 * 1024 / sizeof(std::uint32_t)
+	);
+	const std::vector<std::uint32_t, PageAllocator<std::uint32_t>> Pixels(
+		ScanMiB * 1024 * 1024 / sizeof(std::uint32_t), 0xBEEFFEEB
+	);
+
+	struct
+	{
+		const char* Name;
+		qCachePolicy Policy;
+	} const Policies[] = {
+		{ "Normal         ", { qCacheHint::Normal,         0 } },
+		{ "Prefetch 512   ", { qCacheHint::Normal,       512 } },
+		{ "Prefetch 2048  ", { qCacheHint::Normal,      2048 } },
+		{ "NonTemporal    ", { qCacheHint::NonTemporal,    0 } },
+		{ "NonTemporal 512", { qCacheHint::NonTemporal,  512 } },
+	};
+
+	std::printf(
+		"Working set: %zuMiB | Scan: %zuMiB x%zu\n",
+		WorkingSetMiB, ScanMiB, ScanPasses
+	);
+	std::vector<Result> Results;
+	for( const auto& Entry : Policies )
+	{
+		Results.push_back(Run(Chain, Pixels, &Entry.Policy, 0.0));
+	}
+	const Result Alone = Run(
+		Chain, Pixels, nullptr,
+		ScanPasses * Pixels.size() * sizeof(std::uint32_t)
+			/ Results[0].ScanBytesPerSecond
+	);
+	std::printf(
+		"Alone          :           | %10.3f MChase/s\n",
+		Alone.ChasesPerSecond / 1'000'000.0
+	);
+	for( std::size_t i = 0; i < Results.size(); ++i )
+	{
+		std::printf(
+			"%s: #%08X | %10.3f MChase/s (%6.2f%%) | %8.3f GB/s\n",
+			Policies[i].Name,
+			Results[i].Average,
+			Results[i].ChasesPerSecond / 1'000'000.0,
+			100.0 * Results[i].ChasesPerSecond / Alone.ChasesPerSecond,
+			Results[i].ScanBytesPerSecond / 1'000'000'000.0
+		);
+	}
+	return EXIT_SUCCESS;
+}
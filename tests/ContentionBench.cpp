@@ -0,0 +1,83 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <qAverageColor.hpp>
+
+// Many producers adding partial sums into one running sum
+//  - Mutex: a qColorSum behind a std::mutex
+//  - Shared: qConcurrentColorSum with a single shard, every producer does
+//    atomic adds on the same cache line
+//  - Sharded: qConcurrentColorSum with a shard per hardware thread
+// Producers add the sum of a small tile at a time, so that the cost of
+// updating the shared sum is not hidden behind summing the pixels
+
+constexpr std::size_t TilePixels = 64;
+constexpr std::size_t AddsPerThread = 1'000'000;
+
+struct MutexColorSum
+{
+	std::mutex Mutex;
+	qColorSum Total = {};
+
+	void Add( const std::uint32_t Pixels[], std::size_t Count )
+	{
+		const qColorSum Sum = qSumColor<qChannelOrder::RGBA>(Pixels, Count);
+		std::lock_guard<std::mutex> Lock(Mutex);
+		Total += Sum;
+	}
+};
+
+template< typename AccumulatorT >
+double AddsPerSecond( AccumulatorT& Accumulator, std::size_t ThreadCount )
+{
+	const auto Start = std::chrono::high_resolution_clock::now();
+	std::vector<std::thread> Threads;
+	for( std::size_t i = 0; i < ThreadCount; ++i )
+	{
+		Threads.emplace_back(
+			[&]()
+			{
+				const std::vector<std::uint32_t> Tile(TilePixels, 0xBEEFFEEB);
+				for( std::size_t Add = 0; Add < AddsPerThread; ++Add )
+				{
+					Accumulator.Add(Tile.data(), Tile.size());
+				}
+			}
+		);
+	}
+	for( std::thread& Thread : Threads ) Thread.join();
+	const auto Stop = std::chrono::high_resolution_clock::now();
+	return ThreadCount * AddsPerThread
+		/ std::chrono::duration<double>(Stop - Start).count();
+}
+
+int main( int argc, char* argv[])
+{
+	const std::size_t MaxThreads = argc > 1
+		? std::strtoull(argv[1], nullptr, 10)
+		: std::max(1u, std::thread::hardware_concurrency());
+
+	std::printf("%zu-pixel tiles, %zu adds per thread\n", TilePixels, AddsPerThread);
+	for( std::size_t Threads = 1; Threads <= MaxThreads; Threads *= 2 )
+	{
+		MutexColorSum Mutex;
+		qConcurrentColorSum Shared(1);
+		qConcurrentColorSum Sharded;
+		const double MutexRate   = AddsPerSecond(Mutex, Threads);
+		const double SharedRate  = AddsPerSecond(Shared, Threads);
+		const double ShardedRate = AddsPerSecond(Sharded, Threads);
+		std::printf(
+			"%3zu threads | Mutex: %8.3f MAdd/s | Shared: %8.3f MAdd/s"
+			" | Sharded: %8.3f MAdd/s (x%6.3f) | #%08X #%08X #%08X\n",
+			Threads, MutexRate / 1e6, SharedRate / 1e6, ShardedRate / 1e6,
+			ShardedRate / MutexRate,
+			qColorKernel::PackAverageRGBA8(Mutex.Total),
+			Shared.Average(), Sharded.Average()
+		);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+// Page-backed allocations for the large pixel buffers of the benchmarks and
+// tools. A 40MB buffer spans ten thousand 4KiB pages but only twenty 2MiB
+// pages, and the TLB misses of the former skew every measurement.
+//
+// Huge pages are tried in order of how reliably they are huge:
+//  - MAP_HUGETLB, from the reserved pool(vm.nr_hugepages)
+//  - A 2MiB-aligned anonymous mapping with madvise(MADV_HUGEPAGE), backed by
+//    transparent huge pages as long as the kernel can find them
+//  - Plain 64-byte aligned operator new, on other platforms
+enum class PageSize
+{
+	// Ordinary pages, with transparent huge pages opted out of
+	Small,
+	Huge
+};
+
+constexpr std::size_t HugePageSize = 2 * 1024 * 1024;
+
+// How an allocation ended up being backed
+enum class PageBacking
+{
+	Small,
+	HugeTLB,
+	Transparent,
+	Heap
+};
+
+inline const char* PageBackingName( PageBacking Backing )
+{
+	switch( Backing )
+	{
+	case PageBacking::Small:       return "4KiB pages";
+	case PageBacking::HugeTLB:     return "2MiB pages(MAP_HUGETLB)";
+	case PageBacking::Transparent: return "2MiB pages(MADV_HUGEPAGE)";
+	case PageBacking::Heap:        return "heap";
+	}
+	return "";
+}
+
+inline std::size_t RoundToHugePages( std::size_t Size )
+{
+	return (Size + HugePageSize - 1) & ~(HugePageSize - 1);
+}
+
+inline void* AllocatePages( std::size_t Size, PageSize Pages, PageBacking* Backing = nullptr )
+{
+	PageBacking Used = PageBacking::Heap;
+	void* Data = nullptr;
+#if defined(__linux__)
+	const std::size_t Rounded = RoundToHugePages(Size);
+	if( Pages == PageSize::Huge )
+	{
+		Data = mmap(
+			nullptr, Rounded, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0
+		);
+		Used = PageBacking::HugeTLB;
+	}
+	if( Data == nullptr || Data == MAP_FAILED )
+	{
+		// Over-allocate so that the mapping can be trimmed down to a 2MiB
+		// aligned one, transparent huge pages are only used for aligned
+		// 2MiB ranges
+		std::uint8_t* Mapping = static_cast<std::uint8_t*>(
+			mmap(
+				nullptr, Rounded + HugePageSize, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+			)
+		);
+		if( Mapping == MAP_FAILED ) throw std::bad_alloc();
+		std::uint8_t* Aligned = reinterpret_cast<std::uint8_t*>(
+			RoundToHugePages(reinterpret_cast<std::uintptr_t>(Mapping))
+		);
+		if( Aligned != Mapping ) munmap(Mapping, Aligned - Mapping);
+		munmap(Aligned + Rounded, (Mapping + HugePageSize) - Aligned);
+		madvise(
+			Aligned, Rounded,
+			Pages == PageSize::Huge ? MADV_HUGEPAGE : MADV_NOHUGEPAGE
+		);
+		Data = Aligned;
+		Used = Pages == PageSize::Huge ? PageBacking::Transparent : PageBacking::Small;
+	}
+#else
+	(void)Pages;
+	Data = ::operator new(Size, std::align_val_t(64));
+#endif
+	if( Backing ) *Backing = Used;
+	return Data;
+}
+
+inline void FreePages( void* Data, std::size_t Size )
+{
+	if( Data == nullptr ) return;
+#if defined(__linux__)
+	munmap(Data, RoundToHugePages(Size));
+#else
+	(void)Size;
+	::operator delete(Data, std::align_val_t(64));
+#endif
+}
+
+// std::vector<std::uint32_t, PageAllocator<std::uint32_t>>
+template< typename T, PageSize Pages = PageSize::Huge >
+struct PageAllocator
+{
+	using value_type = T;
+
+	template< typename U >
+	struct rebind
+	{
+		using other = PageAllocator<U, Pages>;
+	};
+
+	PageAllocator() = default;
+	template< typename U >
+	PageAllocator( const PageAllocator<U, Pages>& )
+	{
+	}
+
+	T* allocate( std::size_t Count )
+	{
+		return static_cast<T*>(AllocatePages(Count * sizeof(T), Pages));
+	}
+	void deallocate( T* Data, std::size_t Count )
+	{
+		FreePages(Data, Count * sizeof(T));
+	}
+
+	template< typename U >
+	bool operator==( const PageAllocator<U, Pages>& ) const
+	{
+		return true;
+	}
+	template< typename U >
+	bool operator!=( const PageAllocator<U, Pages>& ) const
+	{
+		return false;
+	}
+};
@@ -0,0 +1,257 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <qAverageColor.hpp>
+
+#include "stb_image.h"
+
+// Decode-and-average of sequential JPEGs with restart intervals.
+// Restart markers reset the entropy decoder's state, so a run of restart
+// segments that starts on an MCU row is a complete image of its own once it
+// is given a copy of the file's headers with the image height patched to the
+// height of the band. Bands are decoded on separate threads and each one is
+// summed right after it is decoded, while it is still in cache, so only a
+// band per thread is ever decoded at once rather than the whole image.
+// stb_image only decodes whole images, so a band is the smallest unit that
+// can be summed as it is decoded rather than a row at a time.
+// Chroma upsampling blends neighbouring chroma rows, which a band does not
+// have past its own edges, so subsampled(4:2:x) JPEGs would differ from a
+// whole-image decode along the band seams. Those are not split at all.
+
+struct JPEGLayout
+{
+	std::size_t Width, Height;
+	std::size_t MCUWidth, MCUHeight;
+	// Any component at less than full resolution
+	bool Subsampled;
+	std::size_t RestartInterval;
+	// Offset of the SOF's 16-bit height field
+	std::size_t HeightOffset;
+	// Offset of the SOS marker and of the entropy-coded data that follows it
+	std::size_t ScanHeader, ScanData;
+	// [Begin, End) of each restart segment's entropy-coded data
+	std::vector<std::pair<std::size_t, std::size_t>> Segments;
+};
+
+inline std::size_t ReadBE16( const std::uint8_t Data[] )
+{
+	return (std::size_t(Data[0]) << 8) | Data[1];
+}
+
+// Only single-scan Huffman-coded sequential JPEGs with restart intervals can
+// be split
+inline bool ParseJPEG( const std::uint8_t Data[], std::size_t Size, JPEGLayout& Layout )
+{
+	if( Size < 4 || Data[0] != 0xFF || Data[1] != 0xD8 ) return false;
+	Layout = JPEGLayout{};
+	bool HasFrame = false;
+	std::size_t Components = 0;
+	std::size_t Offset = 2;
+	for( ;; )
+	{
+		// Markers may be preceded by any number of 0xFF fill bytes
+		if( Offset >= Size || Data[Offset] != 0xFF ) return false;
+		while( Offset < Size && Data[Offset] == 0xFF ) ++Offset;
+		if( Offset + 3 > Size ) return false;
+		const std::uint8_t Marker = Data[Offset++];
+		const std::size_t Length = ReadBE16(&Data[Offset]);
+		if( Length < 2 || Offset + Length > Size ) return false;
+		const std::uint8_t* Segment = &Data[Offset];
+
+		if( Marker == 0xC0 || Marker == 0xC1 )
+		{
+			// Baseline or extended sequential, Huffman coded
+			if( Length < 8 ) return false;
+			Layout.HeightOffset = Offset + 3;
+			Layout.Height = ReadBE16(&Segment[3]);
+			Layout.Width  = ReadBE16(&Segment[5]);
+			Components    = Segment[7];
+			if( Components == 0 || Length < 8 + Components * 3 ) return false;
+			std::size_t MaxH = 1, MaxV = 1;
+			for( std::size_t i = 0; i < Components; ++i )
+			{
+				MaxH = std::max<std::size_t>(MaxH, Segment[8 + i * 3 + 1] >> 4);
+				MaxV = std::max<std::size_t>(MaxV, Segment[8 + i * 3 + 1] & 0xF);
+			}
+			for( std::size_t i = 0; i < Components; ++i )
+			{
+				Layout.Subsampled |= (Segment[8 + i * 3 + 1] >> 4) != MaxH
+					|| (Segment[8 + i * 3 + 1] & 0xF) != MaxV;
+			}
+			// Non-interleaved single-component scans are always in 8x8 units
+			Layout.MCUWidth  = Components == 1 ? 8 : MaxH * 8;
+			Layout.MCUHeight = Components == 1 ? 8 : MaxV * 8;
+			HasFrame = true;
+		}
+		else if(
+			(Marker >= 0xC2 && Marker <= 0xCF)
+			&& Marker != 0xC4 && Marker != 0xC8 && Marker != 0xCC
+		)
+		{
+			// Progressive, lossless and arithmetic-coded frames
+			return false;
+		}
+		else if( Marker == 0xDD )
+		{
+			Layout.RestartInterval = ReadBE16(&Segment[2]);
+		}
+		else if( Marker == 0xDA )
+		{
+			// All components have to be within this one scan
+			if( !HasFrame || Segment[2] != Components ) return false;
+			Layout.ScanHeader = Offset - 2;
+			Layout.ScanData = Offset + Length;
+			break;
+		}
+		else if( Marker == 0xD9 )
+		{
+			return false;
+		}
+		Offset += Length;
+	}
+	if( Layout.RestartInterval == 0 || Layout.Width == 0 || Layout.Height == 0 )
+	{
+		return false;
+	}
+
+	// Find the restart markers within the entropy-coded data. 0xFF bytes of
+	// the data itself are always followed by a stuffed 0x00
+	std::size_t Begin = Layout.ScanData;
+	for( std::size_t i = Layout.ScanData; i + 1 < Size; ++i )
+	{
+		if( Data[i] != 0xFF ) continue;
+		const std::uint8_t Marker = Data[i + 1];
+		if( Marker == 0x00 || Marker == 0xFF ) continue;
+		Layout.Segments.emplace_back(Begin, i);
+		if( Marker >= 0xD0 && Marker <= 0xD7 )
+		{
+			Begin = i + 2;
+			++i;
+			continue;
+		}
+		// Anything else ends the scan, and has to be the end of the image
+		return Marker == 0xD9;
+	}
+	return false;
+}
+
+// Sums the pixels of a JPEG a band at a time on Threads threads. Returns false
+// for JPEGs that can not be split into at least two bands, or that would not
+// match a whole-image decode once split, which have to be decoded whole
+inline bool SumJPEGBands(
+	const std::uint8_t Data[], std::size_t Size, std::size_t Threads,
+	qColorSum& Sum
+)
+{
+	JPEGLayout Layout;
+	if( !ParseJPEG(Data, Size, Layout) || Layout.Subsampled ) return false;
+
+	const std::size_t MCUsPerRow =
+		(Layout.Width + Layout.MCUWidth - 1) / Layout.MCUWidth;
+	const std::size_t MCURows =
+		(Layout.Height + Layout.MCUHeight - 1) / Layout.MCUHeight;
+	const std::size_t SegmentCount =
+		(MCUsPerRow * MCURows + Layout.RestartInterval - 1) / Layout.RestartInterval;
+	if( Layout.Segments.size() != SegmentCount ) return false;
+
+	// Bands are cut at restart segments that start on an MCU row. They are
+	// made small enough that a decoded band stays within the L2 cache, but no
+	// smaller than what it takes to give every thread something to do
+	const std::size_t BandPixels = std::min<std::size_t>(
+		Layout.Width * Layout.Height / std::max<std::size_t>(Threads, 1),
+		128 * 1024
+	);
+	// Segment index of where each band starts, and where the last one ends
+	std::vector<std::size_t> Bands = { 0 };
+	for( std::size_t Segment = 1; Segment < SegmentCount; ++Segment )
+	{
+		const std::size_t MCU = Segment * Layout.RestartInterval;
+		if( MCU % MCUsPerRow != 0 ) continue;
+		const std::size_t Rows =
+			(MCU - Bands.back() * Layout.RestartInterval) / MCUsPerRow;
+		if( Rows * Layout.MCUHeight * Layout.Width >= BandPixels )
+		{
+			Bands.push_back(Segment);
+		}
+	}
+	Bands.push_back(SegmentCount);
+	if( Bands.size() < 3 ) return false;
+
+	std::atomic<std::size_t> NextBand(0);
+	std::atomic<bool> Failed(false);
+	std::mutex SumMutex;
+	Sum = qColorSum{};
+
+	const auto Worker = [&]()
+	{
+		qColorSum ThreadSum = {};
+		std::vector<std::uint8_t> BandJPEG;
+		for(
+			std::size_t Band = NextBand++;
+			Band + 1 < Bands.size() && !Failed;
+			Band = NextBand++
+		)
+		{
+			const std::size_t First = Bands[Band], Last = Bands[Band + 1];
+			const std::size_t FirstRow =
+				First * Layout.RestartInterval / MCUsPerRow * Layout.MCUHeight;
+			const std::size_t LastRow = std::min(
+				(Last * Layout.RestartInterval + MCUsPerRow - 1) / MCUsPerRow
+					* Layout.MCUHeight,
+				Layout.Height
+			);
+			const std::size_t Height = LastRow - FirstRow;
+
+			// Headers, with the height of just this band
+			BandJPEG.assign(Data, Data + Layout.ScanData);
+			BandJPEG[Layout.HeightOffset + 0] = std::uint8_t(Height >> 8);
+			BandJPEG[Layout.HeightOffset + 1] = std::uint8_t(Height);
+			// Restart segments, renumbered to start at RST0
+			for( std::size_t Segment = First; Segment < Last; ++Segment )
+			{
+				BandJPEG.insert(
+					BandJPEG.end(),
+					Data + Layout.Segments[Segment].first,
+					Data + Layout.Segments[Segment].second
+				);
+				if( Segment + 1 < Last )
+				{
+					BandJPEG.push_back(0xFF);
+					BandJPEG.push_back(std::uint8_t(0xD0 + (Segment - First) % 8));
+				}
+			}
+			BandJPEG.push_back(0xFF);
+			BandJPEG.push_back(0xD9);
+
+			int Width, BandHeight, Channels;
+			std::uint8_t* Pixels = stbi_load_from_memory(
+				BandJPEG.data(), static_cast<int>(BandJPEG.size()),
+				&Width, &BandHeight, &Channels, 4
+			);
+			if( Pixels == nullptr )
+			{
+				Failed = true;
+				break;
+			}
+			ThreadSum += qSumColor<qChannelOrder::RGBA>(
+				reinterpret_cast<const std::uint32_t*>(Pixels),
+				static_cast<std::size_t>(Width) * BandHeight
+			);
+			stbi_image_free(Pixels);
+		}
+		std::lock_guard<std::mutex> Lock(SumMutex);
+		Sum += ThreadSum;
+	};
+
+	std::vector<std::thread> Workers;
+	for( std::size_t i = 1; i < Threads; ++i ) Workers.emplace_back(Worker);
+	Worker();
+	for( std::thread& Thread : Workers ) Thread.join();
+	return !Failed;
+}
@@ -0,0 +1,1148 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <qAverageColor.hpp>
+
+// Every kernel against a plain scalar loop over the same pixels. The lengths
+// leave each SIMD tier(4, 8, 16, 32 and 64 pixels at a time) with a ragged
+// tail of every size
+constexpr std::size_t Lengths[] = {
+	0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 67,
+	127, 129, 255, 1000, 4099, 65537
+};
+
+std::size_t Checks = 0, Mismatches = 0;
+
+void Check( const char* Name, std::size_t Count, bool Match )
+{
+	++Checks;
+	if( Match ) return;
+	++Mismatches;
+	std::printf("%s: mismatch with %zu pixels\n", Name, Count);
+}
+
+bool SameSum( const qColorSum& A, const qColorSum& B )
+{
+	return A.Red == B.Red && A.Green == B.Green && A.Blue == B.Blue
+		&& A.Alpha == B.Alpha && A.Count == B.Count;
+}
+
+// Sums of the RGBA8 pixels that Include(i) selects
+template< typename IncludeT >
+qColorSum ReferenceSumRGBA8(
+	const std::uint32_t Pixels[], std::size_t Count, IncludeT&& Include
+)
+{
+	qColorSum Sum = {};
+	for( std::size_t i = 0; i < Count; ++i )
+	{
+		if( !Include(i) ) continue;
+		Sum.Red   += (Pixels[i] >>  0) & 0xFF;
+		Sum.Green += (Pixels[i] >>  8) & 0xFF;
+		Sum.Blue  += (Pixels[i] >> 16) & 0xFF;
+		Sum.Alpha += (Pixels[i] >> 24) & 0xFF;
+		++Sum.Count;
+	}
+	return Sum;
+}
+
+void CheckFilters( std::mt19937& Random )
+{
+	constexpr std::uint32_t Key       = 0xFF00FF00;
+	constexpr std::uint32_t Tolerance = 0xFF101010;
+	for( const std::size_t Count : Lengths )
+	{
+		std::vector<std::uint32_t> Pixels(Count);
+		std::vector<std::uint8_t> ByteMask(Count), BitMask((Count + 7) / 8);
+		for( std::size_t i = 0; i < Count; ++i )
+		{
+			// Half of the pixels are close enough to the key to be excluded
+			Pixels[i] = Random() % 2 ? Random() : (Key ^ (Random() & 0x0F0F0F0F));
+			ByteMask[i] = Random() % 2 ? std::uint8_t(Random()) : 0;
+		}
+		for( std::uint8_t& Bits : BitMask ) Bits = std::uint8_t(Random());
+
+		Check(
+			"ByteMask", Count,
+			SameSum(
+				qSumColorRGBA8ByteMask(Pixels.data(), ByteMask.data(), Count),
+				ReferenceSumRGBA8(
+					Pixels.data(), Count,
+					[&]( std::size_t i ) { return ByteMask[i] != 0; }
+				)
+			)
+		);
+		Check(
+			"BitMask", Count,
+			SameSum(
+				qSumColorRGBA8BitMask(Pixels.data(), BitMask.data(), Count),
+				ReferenceSumRGBA8(
+					Pixels.data(), Count,
+					[&]( std::size_t i ) { return (BitMask[i / 8] >> (i % 8)) & 1; }
+				)
+			)
+		);
+		Check(
+			"ChromaKey", Count,
+			SameSum(
+				qSumColorRGBA8ChromaKey(Pixels.data(), Count, Key, Tolerance),
+				ReferenceSumRGBA8(
+					Pixels.data(), Count,
+					[&]( std::size_t i )
+					{
+						// Kept when any channel is out of tolerance
+						for( std::size_t Shift = 0; Shift < 32; Shift += 8 )
+						{
+							const int Difference = int((Pixels[i] >> Shift) & 0xFF)
+								- int((Key >> Shift) & 0xFF);
+							if( std::abs(Difference) > int((Tolerance >> Shift) & 0xFF) )
+							{
+								return true;
+							}
+						}
+						return false;
+					}
+				)
+			)
+		);
+	}
+}
+
+// RGBA16 is biased by 0x8000 into signed words for vpmaddwd, so the channel
+// values either side of the bias and the extremes are all checked, along with
+// a run long enough to span several of the bounded 32-bit inner loops
+void CheckRGBA16( std::mt19937& Random )
+{
+	const std::uint16_t Channels[] = { 0x0000, 0x7FFF, 0x8000, 0x8001, 0xFFFF };
+	const auto ReferenceSum = []( const std::vector<std::uint64_t>& Pixels )
+	{
+		qColorSum Sum = {};
+		for( const std::uint64_t Pixel : Pixels )
+		{
+			Sum.Red   += (Pixel >>  0) & 0xFFFF;
+			Sum.Green += (Pixel >> 16) & 0xFFFF;
+			Sum.Blue  += (Pixel >> 32) & 0xFFFF;
+			Sum.Alpha += (Pixel >> 48) & 0xFFFF;
+		}
+		Sum.Count = Pixels.size();
+		return Sum;
+	};
+
+	std::vector<std::size_t> Counts(std::begin(Lengths), std::end(Lengths));
+	Counts.push_back(300007);
+	for( const std::size_t Count : Counts )
+	{
+		std::vector<std::uint64_t> Random16(Count), Extremes(Count), Saturated(Count);
+		for( std::size_t i = 0; i < Count; ++i )
+		{
+			Random16[i] = (std::uint64_t(Random()) << 32) | Random();
+			for( std::size_t Shift = 0; Shift < 64; Shift += 16 )
+			{
+				Extremes[i] |= std::uint64_t(Channels[Random() % 5]) << Shift;
+			}
+			Saturated[i] = ~std::uint64_t(0);
+		}
+		for( const auto* Pixels : { &Random16, &Extremes, &Saturated } )
+		{
+			Check(
+				"RGBA16", Count,
+				SameSum(qSumColorRGBA16(Pixels->data(), Count), ReferenceSum(*Pixels))
+			);
+			if( Count == 0 ) continue;
+			Check(
+				"RGBA16 average", Count,
+				qAverageColorRGBA16(Pixels->data(), Count)
+					== AverageColorRGBA16(Pixels->data(), Count)
+			);
+		}
+	}
+}
+
+// IEEE half-float to float, bit by bit rather than through F16C like the
+// kernel. Infinities and NaNs are never generated
+float HalfToFloat( std::uint16_t Half )
+{
+	const int Exponent = (Half >> 10) & 0x1F;
+	const int Mantissa = Half & 0x3FF;
+	const float Value = Exponent == 0
+		? std::ldexp(float(Mantissa), -24)
+		: std::ldexp(float(Mantissa | 0x400), Exponent - 25);
+	return (Half & 0x8000) ? -Value : Value;
+}
+
+// Float averages are compared against double-precision sums, to within the
+// precision of a float. The large-offset pixels are where a plain float sum
+// would drift far beyond that and the Kahan folding has to hold up
+void CheckFloat( std::mt19937& Random )
+{
+	std::uniform_real_distribution<float> Unit(0.0f, 1.0f);
+	const auto Near = []( const std::array<float, 4>& Average, const double Reference[4] )
+	{
+		for( std::size_t Channel = 0; Channel < 4; ++Channel )
+		{
+			const double Tolerance = 1e-6 * std::fmax(1.0, std::fabs(Reference[Channel]));
+			if( std::fabs(Average[Channel] - Reference[Channel]) > Tolerance ) return false;
+		}
+		return true;
+	};
+
+	std::vector<std::size_t> Counts(std::begin(Lengths), std::end(Lengths));
+	Counts.push_back(1000003);
+	for( const std::size_t Count : Counts )
+	{
+		if( Count == 0 ) continue;
+		for( const float Offset : { 0.0f, 10000.0f } )
+		{
+			std::vector<float> Pixels(Count * 4);
+			double Reference[4] = {};
+			for( std::size_t i = 0; i < Count * 4; ++i )
+			{
+				Pixels[i] = Offset + Unit(Random);
+				Reference[i % 4] += Pixels[i];
+			}
+			for( double& Channel : Reference ) Channel /= double(Count);
+			Check(
+				Offset ? "RGBA32F, offset" : "RGBA32F", Count,
+				Near(qAverageColorRGBA32F(Pixels.data(), Count), Reference)
+			);
+		}
+
+		std::vector<std::uint16_t> Halves(Count * 4);
+		double Reference[4] = {};
+		for( std::size_t i = 0; i < Count * 4; ++i )
+		{
+			// Any finite, positive half, subnormals included
+			Halves[i] = std::uint16_t(Random() % (0x7C00));
+			Reference[i % 4] += HalfToFloat(Halves[i]);
+		}
+		for( double& Channel : Reference ) Channel /= double(Count);
+		Check(
+			"RGBA16F", Count, Near(qAverageColorRGBA16F(Halves.data(), Count), Reference)
+		);
+	}
+}
+
+// Channel bit offsets and widths of a packed format, a width of 0 is absent
+struct PackedLayout
+{
+	std::uint32_t Shift[4];
+	std::uint32_t Bits[4];
+};
+
+template< typename PixelT >
+qColorSum ReferenceSumPacked(
+	const std::vector<PixelT>& Pixels, const PackedLayout& Layout
+)
+{
+	std::uint64_t Sums[4] = {};
+	for( const PixelT Pixel : Pixels )
+	{
+		for( std::size_t Channel = 0; Channel < 4; ++Channel )
+		{
+			const std::uint32_t Mask = (1u << Layout.Bits[Channel]) - 1;
+			Sums[Channel] += (Pixel >> Layout.Shift[Channel]) & Mask;
+		}
+	}
+	return qColorSum{ Sums[0], Sums[1], Sums[2], Sums[3], Pixels.size() };
+}
+
+std::uint64_t ReferencePackAverage( const qColorSum& Sum, const PackedLayout& Layout )
+{
+	const std::uint64_t Sums[4] = { Sum.Red, Sum.Green, Sum.Blue, Sum.Alpha };
+	std::uint64_t Packed = 0;
+	for( std::size_t Channel = 0; Channel < 4; ++Channel )
+	{
+		Packed |= (Sums[Channel] / Sum.Count) << Layout.Shift[Channel];
+	}
+	return Packed;
+}
+
+std::uint32_t ReferencePackRGBA8( const qColorSum& Sum, const PackedLayout& Layout )
+{
+	const std::uint64_t Sums[4] = { Sum.Red, Sum.Green, Sum.Blue, Sum.Alpha };
+	std::uint32_t Packed = 0;
+	for( std::size_t Channel = 0; Channel < 4; ++Channel )
+	{
+		std::uint64_t Value = 0xFF;
+		if( Layout.Bits[Channel] )
+		{
+			const std::uint64_t Range = Sum.Count * ((1u << Layout.Bits[Channel]) - 1);
+			Value = (Sums[Channel] * 0xFF + Range / 2) / Range;
+		}
+		Packed |= std::uint32_t(Value) << (Channel * 8);
+	}
+	return Packed;
+}
+
+template< typename PixelT, typename SumT, typename AverageT, typename ToRGBA8T >
+void CheckPackedFormat(
+	const char* Name, const PackedLayout& Layout, const std::vector<PixelT>& Pixels,
+	SumT&& SumColor, AverageT&& AverageColor, ToRGBA8T&& AverageColorToRGBA8
+)
+{
+	const std::size_t Count = Pixels.size();
+	const qColorSum Reference = ReferenceSumPacked(Pixels, Layout);
+	Check(Name, Count, SameSum(SumColor(Pixels.data(), Count), Reference));
+	if( Count == 0 ) return;
+	Check(
+		Name, Count,
+		AverageColor(Pixels.data(), Count) == ReferencePackAverage(Reference, Layout)
+	);
+	Check(
+		Name, Count,
+		AverageColorToRGBA8(Pixels.data(), Count) == ReferencePackRGBA8(Reference, Layout)
+	);
+}
+
+// Packed 16 and 32-bit formats, random and saturated pixels. RGB10A2 sums
+// its 10-bit channels in 32-bit lanes for SPANADD10 iterations at a time, so
+// one saturated run is long enough to take the widest(16 pixel) tier through
+// that bound more than once, with a ragged tail
+void CheckPacked( std::mt19937& Random )
+{
+	constexpr PackedLayout RGB565   = { { 11,  5,  0,  0 }, {  5,  6,  5, 0 } };
+	constexpr PackedLayout RGBA4444 = { { 12,  8,  4,  0 }, {  4,  4,  4, 4 } };
+	constexpr PackedLayout RGB10A2  = { {  0, 10, 20, 30 }, { 10, 10, 10, 2 } };
+
+	for( const std::size_t Count : Lengths )
+	{
+		std::vector<std::uint16_t> Pixels16(Count), Saturated16(Count, 0xFFFF);
+		std::vector<std::uint32_t> Pixels32(Count), Saturated32(Count, 0xFFFFFFFF);
+		for( std::size_t i = 0; i < Count; ++i )
+		{
+			Pixels16[i] = std::uint16_t(Random());
+			Pixels32[i] = Random();
+		}
+		for( const auto* Pixels : { &Pixels16, &Saturated16 } )
+		{
+			CheckPackedFormat(
+				"RGB565", RGB565, *Pixels, qSumColorRGB565,
+				qAverageColorRGB565, qAverageColorRGB565ToRGBA8
+			);
+			CheckPackedFormat(
+				"RGBA4444", RGBA4444, *Pixels, qSumColorRGBA4444,
+				qAverageColorRGBA4444, qAverageColorRGBA4444ToRGBA8
+			);
+		}
+		for( const auto* Pixels : { &Pixels32, &Saturated32 } )
+		{
+			CheckPackedFormat(
+				"RGB10A2", RGB10A2, *Pixels, qSumColorRGB10A2,
+				qAverageColorRGB10A2, qAverageColorRGB10A2ToRGBA8
+			);
+		}
+	}
+
+	constexpr std::size_t SpanAdd10 = 0xFFFFFFFF / 0x3FF;
+	const std::vector<std::uint32_t> Saturated(16 * SpanAdd10 * 2 + 1001, 0xFFFFFFFF);
+	CheckPackedFormat(
+		"RGB10A2, saturated", RGB10A2, Saturated, qSumColorRGB10A2,
+		qAverageColorRGB10A2, qAverageColorRGB10A2ToRGBA8
+	);
+}
+
+// The same conversion as the library, so that only the plane sums are being
+// compared
+std::uint32_t ReferenceYCbCrToRGBA8(
+	double Luma, double Cb, double Cr, qYUVMatrix Matrix, bool FullRange
+)
+{
+	const double Kr = Matrix == qYUVMatrix::BT709 ? 0.2126 : 0.299;
+	const double Kb = Matrix == qYUVMatrix::BT709 ? 0.0722 : 0.114;
+	const double Kg = 1.0 - Kr - Kb;
+	if( FullRange )
+	{
+		Cb -= 128.0;
+		Cr -= 128.0;
+	}
+	else
+	{
+		Luma = (Luma - 16.0)  * (255.0 / 219.0);
+		Cb   = (Cb   - 128.0) * (255.0 / 224.0);
+		Cr   = (Cr   - 128.0) * (255.0 / 224.0);
+	}
+	const double Channels[3] = {
+		Luma + 2.0 * (1.0 - Kr) * Cr,
+		Luma - (2.0 * Kb * (1.0 - Kb) / Kg) * Cb - (2.0 * Kr * (1.0 - Kr) / Kg) * Cr,
+		Luma + 2.0 * (1.0 - Kb) * Cb
+	};
+	std::uint32_t Packed = 0xFFu << 24;
+	for( std::size_t Channel = 0; Channel < 3; ++Channel )
+	{
+		Packed |= std::uint32_t(std::lround(std::clamp(Channels[Channel], 0.0, 255.0)))
+			<< (Channel * 8);
+	}
+	return Packed;
+}
+
+// NV12, I420 and YUY2 planes of odd and even sizes, both matrices and ranges.
+// Every row is padded out with bytes that must never be summed. An odd YUY2
+// width has no chroma for its last pixel, which is skipped
+void CheckYUV( std::mt19937& Random )
+{
+	constexpr std::size_t Widths[]  = { 1, 2, 3, 5, 16, 17, 33, 63, 64, 65, 127, 129, 257, 1001 };
+	constexpr std::size_t Heights[] = { 1, 2, 3, 7, 32, 33 };
+	constexpr std::size_t Padding   = 67;
+	const auto RandomPlane = [&]( std::size_t Size )
+	{
+		std::vector<std::uint8_t> Plane(Size);
+		for( std::uint8_t& Byte : Plane ) Byte = std::uint8_t(Random());
+		return Plane;
+	};
+	// Sum of every Step'th byte of a Width x Height plane, from Offset
+	const auto SumPlane = [](
+		const std::vector<std::uint8_t>& Plane, std::size_t Stride,
+		std::size_t Width, std::size_t Height, std::size_t Offset, std::size_t Step
+	)
+	{
+		std::uint64_t Sum = 0;
+		for( std::size_t y = 0; y < Height; ++y )
+		{
+			for( std::size_t x = 0; x < Width; ++x )
+			{
+				Sum += Plane[y * Stride + x * Step + Offset];
+			}
+		}
+		return Sum;
+	};
+
+	for( const std::size_t Width : Widths )
+	{
+		for( const std::size_t Height : Heights )
+		{
+			const std::size_t ChromaWidth  = (Width  + 1) / 2;
+			const std::size_t ChromaHeight = (Height + 1) / 2;
+			const std::size_t LumaStride = Width + Padding;
+			const std::size_t PairStride = ChromaWidth * 2 + Padding;
+			const std::size_t ChromaStride = ChromaWidth + Padding;
+			const std::size_t YUY2Stride = Width * 2 + Padding;
+			const auto Luma   = RandomPlane(LumaStride * Height);
+			const auto Pairs  = RandomPlane(PairStride * ChromaHeight);
+			const auto Cb     = RandomPlane(ChromaStride * ChromaHeight);
+			const auto Cr     = RandomPlane(ChromaStride * ChromaHeight);
+			const auto Packed = RandomPlane(YUY2Stride * Height);
+
+			const double LumaAverage = SumPlane(Luma, LumaStride, Width, Height, 0, 1)
+				/ double(Width * Height);
+			const double ChromaCount = double(ChromaWidth * ChromaHeight);
+			const std::size_t PairCount = Width / 2;
+			const double YUY2ChromaCount = double(PairCount * Height);
+			const double YUY2Luma
+				= (SumPlane(Packed, YUY2Stride, PairCount, Height, 0, 4)
+				+  SumPlane(Packed, YUY2Stride, PairCount, Height, 2, 4))
+				/ (YUY2ChromaCount * 2.0);
+
+			for( const qYUVMatrix Matrix : { qYUVMatrix::BT601, qYUVMatrix::BT709 } )
+			{
+				for( const bool FullRange : { false, true } )
+				{
+					Check(
+						"NV12", Width * Height,
+						qAverageColorNV12(
+							Luma.data(), LumaStride, Pairs.data(), PairStride,
+							Width, Height, Matrix, FullRange
+						) == ReferenceYCbCrToRGBA8(
+							LumaAverage,
+							SumPlane(Pairs, PairStride, ChromaWidth, ChromaHeight, 0, 2) / ChromaCount,
+							SumPlane(Pairs, PairStride, ChromaWidth, ChromaHeight, 1, 2) / ChromaCount,
+							Matrix, FullRange
+						)
+					);
+					Check(
+						"I420", Width * Height,
+						qAverageColorI420(
+							Luma.data(), LumaStride, Cb.data(), ChromaStride,
+							Cr.data(), ChromaStride, Width, Height, Matrix, FullRange
+						) == ReferenceYCbCrToRGBA8(
+							LumaAverage,
+							SumPlane(Cb, ChromaStride, ChromaWidth, ChromaHeight, 0, 1) / ChromaCount,
+							SumPlane(Cr, ChromaStride, ChromaWidth, ChromaHeight, 0, 1) / ChromaCount,
+							Matrix, FullRange
+						)
+					);
+					if( PairCount == 0 ) continue;
+					Check(
+						"YUY2", Width * Height,
+						qAverageColorYUY2(
+							Packed.data(), YUY2Stride, Width, Height, Matrix, FullRange
+						) == ReferenceYCbCrToRGBA8(
+							YUY2Luma,
+							SumPlane(Packed, YUY2Stride, PairCount, Height, 1, 4) / YUY2ChromaCount,
+							SumPlane(Packed, YUY2Stride, PairCount, Height, 3, 4) / YUY2ChromaCount,
+							Matrix, FullRange
+						)
+					);
+				}
+			}
+		}
+	}
+}
+
+// Byte offset of each of R, G, B, A within a pixel of Order, -1 for padding.
+// Written out again here rather than taken from the kernel's own table
+template< qChannelOrder Order >
+constexpr std::array<int, 4> OrderOffsets()
+{
+	switch( Order )
+	{
+	case qChannelOrder::RGBA: return {{  0,  1,  2,  3 }};
+	case qChannelOrder::BGRA: return {{  2,  1,  0,  3 }};
+	case qChannelOrder::ARGB: return {{  1,  2,  3,  0 }};
+	case qChannelOrder::ABGR: return {{  3,  2,  1,  0 }};
+	case qChannelOrder::RGBX: return {{  0,  1,  2, -1 }};
+	case qChannelOrder::BGRX: return {{  2,  1,  0, -1 }};
+	case qChannelOrder::XRGB: return {{  1,  2,  3, -1 }};
+	case qChannelOrder::XBGR: return {{  3,  2,  1, -1 }};
+	}
+	return {{ 0, 1, 2, 3 }};
+}
+
+// Every channel order through the public entry points and through each ISA
+// tier of the kernel. Padded orders have random bytes in their padding, which
+// must not leak into any channel, and are reported as opaque
+template< qChannelOrder Order >
+void CheckChannelOrder( const char* Name, const std::vector<std::uint32_t>& Pixels )
+{
+	using FormatT = qColorKernel::OrderFormat<Order>;
+	constexpr std::array<int, 4> Offsets = OrderOffsets<Order>();
+	const std::size_t Count = Pixels.size();
+
+	std::uint64_t Sums[4] = {};
+	for( const std::uint32_t Pixel : Pixels )
+	{
+		for( std::size_t Channel = 0; Channel < 4; ++Channel )
+		{
+			Sums[Channel] += Offsets[Channel] < 0
+				? 0xFF : (Pixel >> (Offsets[Channel] * 8)) & 0xFF;
+		}
+	}
+	const qColorSum Reference = { Sums[0], Sums[1], Sums[2], Sums[3], Count };
+
+	Check(Name, Count, SameSum(qSumColor<Order>(Pixels.data(), Count), Reference));
+	Check(
+		Name, Count,
+		SameSum(qColorKernel::Sum<FormatT, qColorKernel::Serial>(Pixels.data(), Count), Reference)
+	);
+	Check(
+		Name, Count,
+		SameSum(qColorKernel::Sum<FormatT, qColorKernel::AVX2>(Pixels.data(), Count), Reference)
+	);
+	Check(
+		Name, Count,
+		qAverageColor<Order>(Pixels.data(), Count)
+			== qColorKernel::PackAverageRGBA8(Reference)
+	);
+}
+
+void CheckChannelOrders( std::mt19937& Random )
+{
+	for( const std::size_t Count : Lengths )
+	{
+		std::vector<std::uint32_t> Pixels(Count);
+		for( std::uint32_t& Pixel : Pixels ) Pixel = Random();
+
+		CheckChannelOrder<qChannelOrder::RGBA>("RGBA", Pixels);
+		CheckChannelOrder<qChannelOrder::BGRA>("BGRA", Pixels);
+		CheckChannelOrder<qChannelOrder::ARGB>("ARGB", Pixels);
+		CheckChannelOrder<qChannelOrder::ABGR>("ABGR", Pixels);
+		CheckChannelOrder<qChannelOrder::RGBX>("RGBX", Pixels);
+		CheckChannelOrder<qChannelOrder::BGRX>("BGRX", Pixels);
+		CheckChannelOrder<qChannelOrder::XRGB>("XRGB", Pixels);
+		CheckChannelOrder<qChannelOrder::XBGR>("XBGR", Pixels);
+		Check(
+			"RGBA8", Count,
+			qAverageColorRGBA8(Pixels.data(), Count)
+				== qAverageColor<qChannelOrder::RGBA>(Pixels.data(), Count)
+		);
+	}
+}
+
+// A stream fed the same pixels in random chunks, split mid-pixel and starting
+// at every misalignment, must come out with the same sums as one call over the
+// whole image
+void CheckStream( std::mt19937& Random )
+{
+	for( const std::size_t Count : Lengths )
+	{
+		for( std::size_t Misalignment = 0; Misalignment < 4; ++Misalignment )
+		{
+			std::vector<std::uint8_t> Bytes(Misalignment + Count * 4 + 3);
+			for( std::uint8_t& Byte : Bytes ) Byte = std::uint8_t(Random());
+			std::vector<std::uint32_t> Pixels(Count);
+			std::memcpy(Pixels.data(), &Bytes[Misalignment], Count * 4);
+
+			qColorStream<qChannelOrder::BGRA> Stream;
+			for( std::size_t Offset = 0; Offset < Count * 4; )
+			{
+				// Mostly small chunks, with the occasional large one
+				const std::size_t Chunk = std::min<std::size_t>(
+					Count * 4 - Offset,
+					Random() % 8 ? 1 + Random() % 67 : 1 + Random() % 4099
+				);
+				Stream.PushBytes(&Bytes[Misalignment + Offset], Chunk);
+				Offset += Chunk;
+			}
+			// Bytes past the last whole pixel are held back, never summed
+			Stream.PushBytes(&Bytes[Misalignment + Count * 4], 3);
+			Check(
+				"Stream", Count,
+				SameSum(
+					Stream.Sum(),
+					qSumColor<qChannelOrder::BGRA>(Pixels.data(), Count)
+				)
+			);
+		}
+	}
+}
+
+// A tiled surface kept up to date through random dirty rectangles, which
+// overlap, hang off the edges or are empty, must always have the same sums as
+// the whole surface summed from scratch
+void CheckTileCache( std::mt19937& Random )
+{
+	struct Surface
+	{
+		std::size_t Width, Height, TileSize;
+	};
+	constexpr Surface Surfaces[] = {
+		{ 1, 1, 64 }, { 63, 65, 64 }, { 333, 157, 64 }, { 333, 157, 16 }, { 1000, 7, 3 }
+	};
+	for( const Surface& Size : Surfaces )
+	{
+		const std::size_t RowPixels = Size.Width + 5;
+		const std::size_t Stride = RowPixels * sizeof(std::uint32_t);
+		std::vector<std::uint32_t> Pixels(RowPixels * Size.Height);
+		for( std::uint32_t& Pixel : Pixels ) Pixel = Random();
+
+		const auto Reference = [&]()
+		{
+			qColorSum Sum = {};
+			for( std::size_t y = 0; y < Size.Height; ++y )
+			{
+				Sum += ReferenceSumRGBA8(
+					&Pixels[y * RowPixels], Size.Width, []( std::size_t ) { return true; }
+				);
+			}
+			return Sum;
+		};
+
+		qTiledColorSum<qChannelOrder::RGBA> Tiled(Size.Width, Size.Height, Size.TileSize);
+		Tiled.Update(Pixels.data(), Stride);
+		Check("Tiled", Size.Width * Size.Height, SameSum(Tiled.Sum(), Reference()));
+
+		for( std::size_t Frame = 0; Frame < 32; ++Frame )
+		{
+			std::vector<qRect> Damage(Random() % 5);
+			for( qRect& Rect : Damage )
+			{
+				// Up to a quarter past the right and bottom edges
+				Rect.X = Random() % (Size.Width  + Size.Width  / 4 + 1);
+				Rect.Y = Random() % (Size.Height + Size.Height / 4 + 1);
+				Rect.Width  = Random() % (Size.Width  / 2 + 2);
+				Rect.Height = Random() % (Size.Height / 2 + 2);
+				for( std::size_t y = Rect.Y; y < std::min(Rect.Y + Rect.Height, Size.Height); ++y )
+				{
+					for( std::size_t x = Rect.X; x < std::min(Rect.X + Rect.Width, Size.Width); ++x )
+					{
+						Pixels[y * RowPixels + x] = Random();
+					}
+				}
+			}
+			Tiled.Update(Pixels.data(), Stride, Damage.data(), Damage.size());
+			Check("Tiled", Size.Width * Size.Height, SameSum(Tiled.Sum(), Reference()));
+		}
+	}
+}
+
+// Frame windows against one call over the same frames laid out back to back,
+// through several trips around the ring and a Reset. Strip windows against one
+// qAverageColorRGBA8Rect call per window
+void CheckSliding( std::mt19937& Random )
+{
+	constexpr std::size_t FramePixels = 67;
+	for( const std::size_t FrameCount : { 1, 2, 3, 8 } )
+	{
+		std::vector<std::uint32_t> Pixels(FramePixels * 40);
+		for( std::uint32_t& Pixel : Pixels ) Pixel = Random();
+
+		qSlidingColorSum<qChannelOrder::RGBA> Window(FrameCount);
+		std::size_t First = 0;
+		for( std::size_t Frame = 0; Frame < 40; ++Frame )
+		{
+			if( Frame == 25 )
+			{
+				Window.Reset();
+				First = Frame;
+			}
+			Window.AddFrame(&Pixels[Frame * FramePixels], FramePixels);
+			First = std::max(First, Frame + 1 < FrameCount ? 0 : Frame + 1 - FrameCount);
+			const std::size_t Count = (Frame + 1 - First) * FramePixels;
+			const std::uint32_t* Oldest = &Pixels[First * FramePixels];
+			Check(
+				"Sliding frames", Count,
+				SameSum(Window.Sum(), qSumColor<qChannelOrder::RGBA>(Oldest, Count))
+				&& Window.Average() == qAverageColorRGBA8(Oldest, Count)
+			);
+		}
+	}
+
+	constexpr std::size_t Width = 131, Height = 37;
+	const std::size_t Stride = (Width + 3) * sizeof(std::uint32_t);
+	std::vector<std::uint32_t> Strip((Width + 3) * Height);
+	for( std::uint32_t& Pixel : Strip ) Pixel = Random();
+	for( const std::size_t Window : { 1, 2, 7, 16, 37 } )
+	{
+		std::vector<std::uint32_t> Averages(Width);
+		qSlidingAverageColorHorizontal(
+			Strip.data(), Stride, Width, Height, Window, Averages.data()
+		);
+		for( std::size_t x = 0; x + Window <= Width; ++x )
+		{
+			Check(
+				"Sliding horizontal", Window * Height,
+				Averages[x] == qAverageColorRGBA8Rect(&Strip[x], Stride, Window, Height)
+			);
+		}
+		qSlidingAverageColorVertical(
+			Strip.data(), Stride, Width, Height, Window, Averages.data()
+		);
+		for( std::size_t y = 0; y + Window <= Height; ++y )
+		{
+			Check(
+				"Sliding vertical", Width * Window,
+				Averages[y] == qAverageColorRGBA8Rect(
+					&Strip[y * (Width + 3)], Stride, Width, Window
+				)
+			);
+		}
+	}
+}
+
+// Decayed running sums of saturated 8K frames, long enough to reach their
+// steady state, must neither overflow nor drift off the frames' own average.
+// Without decay the sums are exact
+void CheckTemporal( std::mt19937& Random )
+{
+	constexpr std::uint64_t FramePixels = 7680 * 4320;
+	const qColorSum White = {
+		FramePixels * 0xFF, FramePixels * 0xFF, FramePixels * 0xFF,
+		FramePixels * 0xFF, FramePixels
+	};
+	for( const double Decay : { 0.0, 0.5, 0.9, 65535.0 / 65536.0, 0.9999999 } )
+	{
+		qTemporalColorSum<qChannelOrder::RGBA> Temporal(Decay);
+		for( std::size_t Frame = 0; Frame < 2000000; ++Frame ) Temporal.AddFrame(White);
+		const qColorSum Sum = Temporal.Sum();
+		Check(
+			"Temporal, saturated", FramePixels,
+			Temporal.Average() == 0xFFFFFFFF && Sum.Count >= FramePixels
+				&& std::fabs(double(Sum.Red) - double(Sum.Count) * 0xFF)
+					<= 1e-9 * double(Sum.Red)
+		);
+	}
+
+	std::vector<std::uint32_t> Pixels(1000);
+	qTemporalColorSum<qChannelOrder::RGBA> Temporal;
+	qColorSum Expected = {};
+	for( std::size_t Frame = 0; Frame < 16; ++Frame )
+	{
+		for( std::uint32_t& Pixel : Pixels ) Pixel = Random();
+		Temporal.AddFrame(Pixels.data(), Pixels.size());
+		Expected += ReferenceSumRGBA8(
+			Pixels.data(), Pixels.size(), []( std::size_t ) { return true; }
+		);
+		Check("Temporal", Pixels.size(), SameSum(Temporal.Sum(), Expected));
+	}
+}
+
+// Random rectangles of images whose widths leave the table's four-pixel steps
+// with every size of tail, and whose rows are padded with pixels that must
+// not leak into the table
+template< typename SumT >
+void CheckSummedAreaTable(
+	const char* Name, std::mt19937& Random, const std::vector<std::uint32_t>& Pixels,
+	std::size_t Stride, std::size_t Width, std::size_t Height
+)
+{
+	const qSummedAreaTable<qChannelOrder::RGBA, SumT> Table(
+		Pixels.data(), Stride, Width, Height
+	);
+	for( std::size_t i = 0; i < 64; ++i )
+	{
+		qRect Rect;
+		Rect.Width  = i ? Random() % (Width + 1) : Width;
+		Rect.Height = i ? Random() % (Height + 1) : Height;
+		Rect.X = Random() % (Width - Rect.Width + 1);
+		Rect.Y = Random() % (Height - Rect.Height + 1);
+		Check(
+			Name, Rect.Width * Rect.Height,
+			SameSum(
+				Table.Sum(Rect),
+				qSumColorRGBA8Rect(
+					&Pixels[Rect.Y * (Stride / sizeof(std::uint32_t)) + Rect.X], Stride,
+					Rect.Width, Rect.Height
+				)
+			)
+		);
+	}
+}
+
+void CheckSummedArea( std::mt19937& Random )
+{
+	for( const std::size_t Width : { 1, 2, 3, 4, 5, 6, 7, 8, 9, 33, 258 } )
+	{
+		const std::size_t Height = 1 + Random() % 40;
+		const std::size_t Stride = (Width + 3) * sizeof(std::uint32_t);
+		std::vector<std::uint32_t> Pixels(Stride / sizeof(std::uint32_t) * Height);
+		for( std::uint32_t& Pixel : Pixels ) Pixel = Random();
+		CheckSummedAreaTable<std::uint32_t>(
+			"Summed-area, 32-bit", Random, Pixels, Stride, Width, Height
+		);
+		CheckSummedAreaTable<std::uint64_t>(
+			"Summed-area, 64-bit", Random, Pixels, Stride, Width, Height
+		);
+	}
+}
+
+// Border zones from each ISA tier against a scalar sum of each zone's own
+// rectangle, on frames with odd sizes, deep borders and as many zones as the
+// frame has rows and columns
+template< typename ISAT >
+void CheckBorderTier(
+	const char* Name, const std::vector<std::uint32_t>& Pixels, std::size_t Stride,
+	std::size_t Width, std::size_t Height, std::size_t Depth,
+	std::size_t HorizontalZones, std::size_t VerticalZones
+)
+{
+	const std::size_t RowPixels = Stride / sizeof(std::uint32_t);
+	const std::size_t Rows    = std::min(Depth, Height / 2);
+	const std::size_t Columns = std::min(Depth, Width / 2);
+	const auto RectSum = [&]( std::size_t X, std::size_t Y, std::size_t W, std::size_t H )
+	{
+		qColorSum Sum = {};
+		for( std::size_t y = Y; y < Y + H; ++y )
+		{
+			Sum += ReferenceSumRGBA8(
+				&Pixels[y * RowPixels + X], W, []( std::size_t ) { return true; }
+			);
+		}
+		return Sum;
+	};
+	// A side zone is the rows whose y * VerticalZones / Height is the zone
+	const auto SideRows = [&]( std::size_t Zone, std::size_t& Begin, std::size_t& End )
+	{
+		Begin = (Zone * Height + VerticalZones - 1) / VerticalZones;
+		End   = ((Zone + 1) * Height + VerticalZones - 1) / VerticalZones;
+	};
+
+	std::vector<qColorSum> Expected;
+	for( std::size_t Zone = 0; Zone < HorizontalZones; ++Zone )
+	{
+		const std::size_t Begin = Zone * Width / HorizontalZones;
+		const std::size_t End   = (Zone + 1) * Width / HorizontalZones;
+		Expected.push_back(RectSum(Begin, 0, End - Begin, Rows));
+	}
+	for( std::size_t Zone = 0; Zone < VerticalZones; ++Zone )
+	{
+		std::size_t Begin, End;
+		SideRows(Zone, Begin, End);
+		Expected.push_back(RectSum(Width - Columns, Begin, Columns, End - Begin));
+	}
+	for( std::size_t Zone = HorizontalZones; Zone-- > 0; )
+	{
+		const std::size_t Begin = Zone * Width / HorizontalZones;
+		const std::size_t End   = (Zone + 1) * Width / HorizontalZones;
+		Expected.push_back(RectSum(Begin, Height - Rows, End - Begin, Rows));
+	}
+	for( std::size_t Zone = VerticalZones; Zone-- > 0; )
+	{
+		std::size_t Begin, End;
+		SideRows(Zone, Begin, End);
+		Expected.push_back(RectSum(0, Begin, Columns, End - Begin));
+	}
+
+	std::vector<qColorSum> Sums(Expected.size());
+	qSumColorBorder<qChannelOrder::RGBA, ISAT>(
+		Pixels.data(), Stride, Width, Height, Depth,
+		HorizontalZones, VerticalZones, Sums.data()
+	);
+	bool Match = true;
+	for( std::size_t Zone = 0; Zone < Sums.size(); ++Zone )
+	{
+		Match &= SameSum(Sums[Zone], Expected[Zone]);
+	}
+	Check(Name, Width * Height, Match);
+}
+
+void CheckBorder( std::mt19937& Random )
+{
+	struct Layout
+	{
+		std::size_t Width, Height, Depth, HorizontalZones, VerticalZones;
+	};
+	constexpr Layout Layouts[] = {
+		{ 1, 1, 1, 1, 1 }, { 2, 3, 1, 2, 3 }, { 37, 23, 5, 7, 3 },
+		{ 37, 23, 100, 37, 23 }, { 131, 67, 17, 16, 9 }, { 300, 41, 33, 0, 5 },
+		{ 300, 41, 33, 6, 0 }
+	};
+	for( const Layout& Frame : Layouts )
+	{
+		const std::size_t Stride = (Frame.Width + 7) * sizeof(std::uint32_t);
+		std::vector<std::uint32_t> Pixels((Frame.Width + 7) * Frame.Height);
+		for( std::uint32_t& Pixel : Pixels ) Pixel = Random();
+		const auto Tier = [&]( auto ISA, const char* Name )
+		{
+			CheckBorderTier<decltype(ISA)>(
+				Name, Pixels, Stride, Frame.Width, Frame.Height, Frame.Depth,
+				Frame.HorizontalZones, Frame.VerticalZones
+			);
+		};
+		Tier(qColorKernel::Serial{}, "Border, Serial");
+		Tier(qColorKernel::AVX2{}, "Border, AVX2");
+		Tier(qColorKernel::NativeISA{}, "Border");
+	}
+}
+
+// A Fraction of 1 or more must be exact, and a NaN one must behave like 0
+// rather than sample an arbitrary number of blocks
+void CheckApproximate( std::mt19937& Random )
+{
+	for( const std::size_t Count : { 0, 1, 1023, 1024, 1025, 65537, 300007 } )
+	{
+		std::vector<std::uint32_t> Pixels(Count);
+		for( std::uint32_t& Pixel : Pixels ) Pixel = Random();
+		const qColorSum Exact = ReferenceSumRGBA8(
+			Pixels.data(), Count, []( std::size_t ) { return true; }
+		);
+		for( const double Fraction : { 1.0, 2.0, double(INFINITY) } )
+		{
+			Check(
+				"Approximate, whole", Count,
+				SameSum(qAverageColorRGBA8Approximate(Pixels.data(), Count, Fraction).Sum, Exact)
+			);
+		}
+		const qColorEstimate None = qAverageColorRGBA8Approximate(Pixels.data(), Count, 0.0);
+		const qColorEstimate NaN  = qAverageColorRGBA8Approximate(Pixels.data(), Count, NAN);
+		Check(
+			"Approximate, NaN", Count,
+			SameSum(None.Sum, NaN.Sum) && None.SampleCount == NaN.SampleCount
+		);
+	}
+}
+
+// Rectangles whose rows are padded with pixels that must not be summed, and
+// batches of mixed sizes with empty images among them, under each kind of
+// prefetching
+const qCachePolicy Policies[] = {
+	{ qCacheHint::Normal,        0, 0 },
+	{ qCacheHint::Normal,      512, 3 },
+	{ qCacheHint::NonTemporal,   0, 1 },
+	{ qCacheHint::NonTemporal, 256, 8 }
+};
+
+void CheckRect( std::mt19937& Random )
+{
+	for( const std::size_t Width : { 0, 1, 3, 15, 16, 17, 33, 67, 129 } )
+	{
+		for( const std::size_t Height : { 0, 1, 2, 7, 31 } )
+		{
+			const std::size_t RowPixels = Width + 1 + Random() % 7;
+			std::vector<std::uint32_t> Pixels(RowPixels * Height + 1);
+			for( std::uint32_t& Pixel : Pixels ) Pixel = Random();
+			qColorSum Expected = {};
+			for( std::size_t y = 0; y < Height; ++y )
+			{
+				Expected += ReferenceSumRGBA8(
+					&Pixels[y * RowPixels], Width, []( std::size_t ) { return true; }
+				);
+			}
+			for( const qCachePolicy& Policy : Policies )
+			{
+				Check(
+					"Rect", Width * Height,
+					SameSum(
+						qSumColorRGBA8Rect(
+							Pixels.data(), RowPixels * sizeof(std::uint32_t),
+							Width, Height, Policy
+						),
+						Expected
+					)
+				);
+			}
+		}
+	}
+}
+
+void CheckBatch( std::mt19937& Random )
+{
+	std::vector<std::vector<std::uint32_t>> Images;
+	for( std::size_t i = 0; i < 48; ++i )
+	{
+		const std::size_t Count = i % 5 == 0 ? 0 : Lengths[Random() % std::size(Lengths)];
+		Images.emplace_back(Count);
+		for( std::uint32_t& Pixel : Images.back() ) Pixel = Random();
+	}
+	std::vector<const std::uint32_t*> Pointers;
+	std::vector<std::size_t> Counts;
+	for( const std::vector<std::uint32_t>& Image : Images )
+	{
+		Pointers.push_back(Image.data());
+		Counts.push_back(Image.size());
+	}
+	for( const qCachePolicy& Policy : Policies )
+	{
+		std::vector<qColorSum> Sums(Images.size());
+		qSumColorRGBA8Batch(
+			Pointers.data(), Counts.data(), Images.size(), Sums.data(), Policy
+		);
+		for( std::size_t i = 0; i < Images.size(); ++i )
+		{
+			Check(
+				"Batch", Counts[i],
+				SameSum(
+					Sums[i],
+					ReferenceSumRGBA8(
+						Images[i].data(), Counts[i], []( std::size_t ) { return true; }
+					)
+				)
+			);
+		}
+	}
+}
+
+// Several threads adding pixels and partial sums at once, into fewer shards
+// than threads, a shard each and the default, must add up to exactly the
+// scalar total once they are done
+void CheckConcurrent( std::mt19937& Random )
+{
+	constexpr std::size_t ThreadCount = 8;
+	std::vector<std::uint32_t> Pixels(ThreadCount * 40000 + 123);
+	for( std::uint32_t& Pixel : Pixels ) Pixel = Random();
+	const qColorSum Expected = ReferenceSumRGBA8(
+		Pixels.data(), Pixels.size(), []( std::size_t ) { return true; }
+	);
+	for( const std::size_t ShardCount : { 1, 3, 8, 0 } )
+	{
+		qConcurrentColorSum Concurrent(ShardCount);
+		std::vector<std::thread> Threads;
+		for( std::size_t t = 0; t < ThreadCount; ++t )
+		{
+			Threads.emplace_back(
+				[&, t]()
+				{
+					// Chunks of every size, some summed up-front
+					const std::size_t Begin = Pixels.size() * t / ThreadCount;
+					const std::size_t End = Pixels.size() * (t + 1) / ThreadCount;
+					for( std::size_t i = Begin; i < End; )
+					{
+						const std::size_t Count = std::min<std::size_t>(End - i, 1 + i % 997);
+						if( i % 2 )
+						{
+							Concurrent.Add(&Pixels[i], Count);
+						}
+						else
+						{
+							Concurrent.Add(qSumColor<qChannelOrder::RGBA>(&Pixels[i], Count));
+						}
+						i += Count;
+					}
+				}
+			);
+		}
+		for( std::thread& Thread : Threads ) Thread.join();
+		Check("Concurrent", Pixels.size(), SameSum(Concurrent.Sum(), Expected));
+		Concurrent.Reset();
+		Check("Concurrent, reset", 0, SameSum(Concurrent.Sum(), qColorSum{}));
+	}
+}
+
+void CheckParallel( std::mt19937& Random )
+{
+	// Up to a few chunks past a whole number of them
+	for( const std::size_t Count : { 0, 1, 262143, 262144, 262145, 1048576 + 4097 } )
+	{
+		std::vector<std::uint32_t> Pixels(Count);
+		for( std::uint32_t& Pixel : Pixels ) Pixel = Random();
+		const qColorSum Expected = ReferenceSumRGBA8(
+			Pixels.data(), Count, []( std::size_t ) { return true; }
+		);
+		for( const std::size_t ThreadCount : { 0, 1, 3 } )
+		{
+			Check(
+				"Parallel", Count,
+				SameSum(qSumColorRGBA8Parallel(Pixels.data(), Count, ThreadCount), Expected)
+			);
+		}
+		Check("NUMA", Count, SameSum(qSumColorRGBA8NUMA(Pixels.data(), Count), Expected));
+	}
+}
+
+void CheckBatchParallel( std::mt19937& Random )
+{
+	// Tiny images that get packed together, and images of a few chunks each
+	// that get split up, so that there are tasks to steal at any thread count
+	std::vector<std::vector<std::uint32_t>> Images;
+	for( std::size_t i = 0; i < 64; ++i )
+	{
+		const std::size_t Count = i % 8 == 7 ? 1 + Random() % 4000000 : Random() % 5000;
+		Images.emplace_back(Count);
+		for( std::uint32_t& Pixel : Images.back() ) Pixel = Random();
+	}
+	std::vector<const std::uint32_t*> Pointers;
+	std::vector<std::size_t> Counts;
+	std::vector<qColorSum> Expected;
+	for( const std::vector<std::uint32_t>& Image : Images )
+	{
+		Pointers.push_back(Image.data());
+		Counts.push_back(Image.size());
+		Expected.push_back(
+			ReferenceSumRGBA8(Image.data(), Image.size(), []( std::size_t ) { return true; })
+		);
+	}
+	for( const std::size_t ThreadCount : { 1, 2, 3, 8, 64 } )
+	{
+		std::vector<qColorSum> Sums(Images.size());
+		qSumColorRGBA8BatchParallel(
+			Pointers.data(), Counts.data(), Images.size(), Sums.data(), ThreadCount
+		);
+		for( std::size_t i = 0; i < Images.size(); ++i )
+		{
+			Check("Batch parallel", Counts[i], SameSum(Sums[i], Expected[i]));
+		}
+	}
+}
+
+int main()
+{
+	std::mt19937 Random(0xBEEF);
+
+	CheckFilters(Random);
+	CheckRGBA16(Random);
+	CheckFloat(Random);
+	CheckPacked(Random);
+	CheckYUV(Random);
+	CheckChannelOrders(Random);
+	CheckStream(Random);
+	CheckTileCache(Random);
+	CheckSliding(Random);
+	CheckTemporal(Random);
+	CheckSummedArea(Random);
+	CheckBorder(Random);
+	CheckApproximate(Random);
+	CheckRect(Random);
+	CheckBatch(Random);
+	CheckConcurrent(Random);
+	CheckParallel(Random);
+	CheckBatchParallel(Random);
+
+	std::printf("%zu checks | %zu mismatches\n", Checks, Mismatches);
+	return Mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <qAverageColor.hpp>
+#include "Bench.hpp"
+#include "HugePages.hpp"
+
+// Software prefetching of upcoming rows and images, against strided access
+//  - Sub-rectangles scattered over a texture atlas much larger than the cache
+//  - A batch of small images scattered over the heap
+
+// 8192 x 8192 atlas, 256MiB
+constexpr std::size_t AtlasWidth  = 8192;
+constexpr std::size_t AtlasHeight = 8192;
+constexpr std::size_t RectCount   = 16384;
+constexpr std::size_t RectSize    = 64;
+
+// 64k separately allocated 32 x 32 images
+constexpr std::size_t ImageCount = 65536;
+constexpr std::size_t ImageSize  = 32 * 32;
+
+constexpr std::size_t Ahead[] = { 0, 1, 2, 4, 8, 16 };
+
+int main()
+{
+	std::mt19937 Random(0xBEEF);
+
+	const std::vector<std::uint32_t, PageAllocator<std::uint32_t>> Atlas(
+		AtlasWidth * AtlasHeight, 0xBEEFFEEB
+	);
+	std::vector<std::size_t> RectOrigins(RectCount);
+	for( std::size_t& Origin : RectOrigins )
+	{
+		const std::size_t x = Random() % (AtlasWidth - RectSize);
+		const std::size_t y = Random() % (AtlasHeight - RectSize);
+		Origin = y * AtlasWidth + x;
+	}
+
+	std::printf(
+		"%zu %zux%zu rects of a %zux%zu atlas\n",
+		RectCount, RectSize, RectSize, AtlasWidth, AtlasHeight
+	);
+	double Baseline = 0.0;
+	for( const std::size_t RowsAhead : Ahead )
+	{
+		qCachePolicy Policy;
+		Policy.PrefetchAhead = RowsAhead;
+		std::uint64_t Check = 0;
+		const double Milliseconds = Bench<BenchMilliseconds>::BenchTime(
+			[&]()
+			{
+				for( const std::size_t Origin : RectOrigins )
+				{
+					Check += qSumColorRGBA8Rect(
+						&Atlas[Origin], AtlasWidth * sizeof(std::uint32_t),
+						RectSize, RectSize, Policy
+					).Red;
+				}
+			}
+		).count();
+		if( RowsAhead == 0 ) Baseline = Milliseconds;
+		std::printf(
+			"Rows ahead %2zu: %10.3fms | Speedup: %f | %llu\n",
+			RowsAhead, Milliseconds, Baseline / Milliseconds,
+			static_cast<unsigned long long>(Check)
+		);
+	}
+
+	// Allocated in a shuffled order, with some unrelated allocations in
+	// between, so consecutive images are nowhere near each other
+	std::vector<std::unique_ptr<std::uint32_t[]>> Storage;
+	std::vector<const std::uint32_t*> Images(ImageCount);
+	for( std::size_t i = 0; i < ImageCount; ++i )
+	{
+		Storage.emplace_back(new std::uint32_t[ImageSize + Random() % 1024]);
+		std::fill_n(Storage.back().get(), ImageSize, 0xBEEFFEEB);
+	}
+	std::shuffle(Storage.begin(), Storage.end(), Random);
+	for( std::size_t i = 0; i < ImageCount; ++i ) Images[i] = Storage[i].get();
+	const std::vector<std::size_t> Counts(ImageCount, ImageSize);
+	std::vector<qColorSum> Sums(ImageCount);
+	// Flush the images out of the cache between runs
+	std::vector<std::uint8_t> Flush(64 * 1024 * 1024);
+
+	std::printf("%zu %zu-pixel images\n", ImageCount, ImageSize);
+	for( const std::size_t ImagesAhead : Ahead )
+	{
+		std::fill(Flush.begin(), Flush.end(), std::uint8_t(ImagesAhead));
+		qCachePolicy Policy;
+		Policy.PrefetchAhead = ImagesAhead;
+		const double Milliseconds = Bench<BenchMilliseconds>::BenchTime(
+			[&]()
+			{
+				qSumColorRGBA8Batch(
+					Images.data(), Counts.data(), ImageCount, Sums.data(), Policy
+				);
+			}
+		).count();
+		if( ImagesAhead == 0 ) Baseline = Milliseconds;
+		std::printf(
+			"Images ahead %2zu: %10.3fms | Speedup: %f | #%08X\n",
+			ImagesAhead, Milliseconds, Baseline / Milliseconds,
+			qColorKernel::PackAverageRGBA8(Sums.back())
+		);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,93 @@
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <qAverageColor.hpp>
+#include "Bench.hpp"
+#include "HugePages.hpp"
+
+// Averages of many arbitrary rectangles of one image, one qAverageColorRGBA8Rect
+// call per rectangle against building a summed-area table once and looking
+// every rectangle up in it
+
+// 2048 x 2048 image, 16MiB
+constexpr std::size_t ImageWidth  = 2048;
+constexpr std::size_t ImageHeight = 2048;
+constexpr std::size_t RectCounts[] = { 16, 256, 4096 };
+
+template< typename SumT >
+void BenchTable(
+	const char* Name, const std::uint32_t Image[],
+	const std::vector<qRect>& Rects, const std::vector<std::uint32_t>& Expected
+)
+{
+	qSummedAreaTable<qChannelOrder::RGBA, SumT> Table;
+	const double BuildMilliseconds = Bench<BenchMilliseconds>::BenchTime(
+		[&]()
+		{
+			Table.Build(
+				Image, ImageWidth * sizeof(std::uint32_t), ImageWidth, ImageHeight
+			);
+		}
+	).count();
+	std::size_t Mismatches = 0;
+	const double QueryMilliseconds = Bench<BenchMilliseconds>::BenchTime(
+		[&]()
+		{
+			for( std::size_t i = 0; i < Rects.size(); ++i )
+			{
+				Mismatches += Table.Average(Rects[i]) != Expected[i];
+			}
+		}
+	).count();
+	std::printf(
+		"\t%s: build %10.3fms + queries %10.3fms | %zu mismatches\n",
+		Name, BuildMilliseconds, QueryMilliseconds, Mismatches
+	);
+}
+
+int main()
+{
+	std::mt19937 Random(0xBEEF);
+
+	std::vector<std::uint32_t, PageAllocator<std::uint32_t>> Image(
+		ImageWidth * ImageHeight
+	);
+	for( std::uint32_t& Pixel : Image ) Pixel = Random();
+
+	for( const std::size_t RectCount : RectCounts )
+	{
+		std::vector<qRect> Rects(RectCount);
+		for( qRect& Rect : Rects )
+		{
+			Rect.Width  = 1 + Random() % ImageWidth;
+			Rect.Height = 1 + Random() % ImageHeight;
+			Rect.X = Random() % (ImageWidth - Rect.Width + 1);
+			Rect.Y = Random() % (ImageHeight - Rect.Height + 1);
+		}
+
+		std::vector<std::uint32_t> Expected(RectCount);
+		const double RectMilliseconds = Bench<BenchMilliseconds>::BenchTime(
+			[&]()
+			{
+				for( std::size_t i = 0; i < RectCount; ++i )
+				{
+					Expected[i] = qAverageColorRGBA8Rect(
+						&Image[Rects[i].Y * ImageWidth + Rects[i].X],
+						ImageWidth * sizeof(std::uint32_t),
+						Rects[i].Width, Rects[i].Height
+					);
+				}
+			}
+		).count();
+		std::printf(
+			"%zu rects of a %zux%zu image\n"
+			"\tPer-rect: %10.3fms\n",
+			RectCount, ImageWidth, ImageHeight, RectMilliseconds
+		);
+		BenchTable<std::uint32_t>("32-bit table", Image.data(), Rects, Expected);
+		BenchTable<std::uint64_t>("64-bit table", Image.data(), Rects, Expected);
+	}
+	return EXIT_SUCCESS;
+}